@@ -14,7 +14,7 @@
 #include "bar.h"
 
 const char* const HELP_MESSAGE =
-"GTK button bar: nwgbar " VERSION_STR " (c) Piotr Miller & Contributors 2021\n\n\
+"GTK button bar: nwgbar-server " VERSION_STR " (c) Piotr Miller & Contributors 2021\n\n\
 Options:\n\
 -h               show this help message and exit\n\
 -v               arrange buttons vertically\n\
@@ -26,11 +26,48 @@ Options:\n\
 -b <background>  background colour in RRGGBB or RRGGBBAA format (RRGGBBAA alpha overrides <opacity>)\n\
 -s <size>        button image size (default: 72)\n\
 -g <theme>       GTK theme name\n\
--wm <wmname>     window manager name (if can not be detected)\n\n\
+-wm <wmname>     window manager name (if can not be detected)\n\
+-oneshot         run in the foreground, exit when window is closed\n\
+                 generally you should not use this option, use simply `nwgbar` instead\n\n\
 [requires layer-shell]:\n\
 -layer-shell-layer          {BACKGROUND,BOTTOM,TOP,OVERLAY},        default: OVERLAY\n\
 -layer-shell-exclusive-zone {auto, valid integer (usually -1 or 0)}, default: auto\n";
 
+/* Keeps the application alive when the window is closed, registers & deregisters */
+struct ServerDriver: public ApplicationDriver {
+    BarInstance instance;
+
+    ServerDriver(const Glib::RefPtr<Gtk::Application>& app, BarWindow& window, IconProvider& icon_provider,
+                 const Glib::RefPtr<Gtk::CssProvider>& css_provider):
+        ApplicationDriver{ app },
+        instance{ *app.get(), "nwgbar-server", window, icon_provider, css_provider }
+    {
+        app->hold();
+    }
+};
+
+/* Does not register application instance, exits once the window is closed */
+struct OneshotDriver: public ApplicationDriver {
+    BarWindow&  window;
+    BarInstance instance;
+
+    OneshotDriver(const Glib::RefPtr<Gtk::Application>& app, BarWindow& window, IconProvider& icon_provider,
+                  const Glib::RefPtr<Gtk::CssProvider>& css_provider):
+        ApplicationDriver{ app },
+        window{ window },
+        instance{ *app.get(), "nwgbar", window, icon_provider, css_provider }
+    {
+        app->hold();
+    }
+    int run() override {
+        window.show(hint::Fullscreen);
+        window.signal_hide().connect([this](){
+            this->app->release();
+        });
+        return ApplicationDriver::run();
+    }
+};
+
 int main(int argc, char *argv[]) {
     try {
         struct timeval tp;
@@ -64,43 +101,16 @@ int main(int argc, char *argv[]) {
 
         BarConfig config {
             input,
-            screen
+            screen,
+            config_dir
         };
 
 	settings->property_gtk_theme_name() = config.theme;
 
-        // default or custom template
-        auto default_bar_file = config_dir / "bar.json";
-        auto custom_bar_file = config_dir / config.definition_file;
-        // copy default anyway if not found
-        if (!fs::exists(default_bar_file)) {
-            try {
-                fs::copy_file(DATA_DIR_STR "/nwgbar/bar.json", default_bar_file, fs::copy_options::overwrite_existing);
-            } catch (...) {
-                Log::error("Failed copying default template");
-            }
-        }
-
-        ns::json bar_json;
-        try {
-            bar_json = json_from_file(custom_bar_file);
-        }  catch (...) {
-            Log::error("Template file not found, using default");
-            bar_json = json_from_file(default_bar_file);
-        }
-        Log::info(bar_json.size(), " bar entries loaded");
-
-        std::vector<BarEntry> bar_entries {};
-        if (bar_json.size() > 0) {
-            bar_entries = get_bar_entries(std::move(bar_json));
-        }
+        auto bar_entries = load_bar_entries(config);
 
         Gtk::StyleContext::add_provider_for_screen(screen, provider, GTK_STYLE_PROVIDER_PRIORITY_USER);
-        {
-            auto css_file = setup_css_file("nwgbar", config_dir, config.css_filename);
-            provider->load_from_path(css_file);
-            Log::info("Using css file \'", css_file, "\'");
-        }
+        load_bar_style(provider, config);
         IconProvider icon_provider {
             Gtk::IconTheme::get_for_screen(screen),
             config.icon_size
@@ -108,45 +118,20 @@ int main(int argc, char *argv[]) {
 
         BarWindow window{ config };
         window.set_background_color(background_color);
-
-        /* Create buttons */
-        for (auto& entry : bar_entries) {
-            auto image = Gtk::make_managed<Gtk::Image>(icon_provider.load_icon(entry.icon));
-            auto& ab = window.boxes.emplace_back(std::move(entry.name),
-                                                 std::move(entry.exec),
-                                                 std::move(entry.icon));
-            ab.set_image_position(Gtk::POS_TOP);
-            ab.set_image(*image);
-            if (!entry.css_class.empty()) {
-                auto && style_context = ab.get_style_context();
-                style_context->add_class(entry.css_class);
-            }
-        }
-
-        int column = 0;
-        int row = 0;
-
-        window.grid.freeze_child_notify();
-        for (auto& box : window.boxes) {
-            window.grid.attach(box, column, row, 1, 1);
-            if (config.orientation == Orientation::Vertical) {
-                row++;
-            } else {
-                column++;
-            }
-        }
-        window.grid.thaw_child_notify();
-        Instance instance{ *app.get(), "nwgbar" };
-
-        window.show_all_children();
-        window.show(hint::Fullscreen);
+        window.set_entries(std::move(bar_entries), icon_provider);
 
         gettimeofday(&tp, NULL);
         long int end_ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
 
         Log::info("Time: ", end_ms - start_ms, "ms");
 
-        return app->run(window);
+        std::unique_ptr<ApplicationDriver> driver;
+        if (config.oneshot) {
+            driver.reset(new OneshotDriver{ app, window, icon_provider, provider });
+        } else {
+            driver.reset(new ServerDriver{ app, window, icon_provider, provider });
+        }
+        return driver->run();
     } catch (const Glib::Error& e) {
         Log::error(e.what());
     } catch (const std::exception& error) {
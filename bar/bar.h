@@ -22,8 +22,10 @@ enum class Orientation: unsigned int { Horizontal = 0, Vertical };
 struct BarConfig: public Config {
     int icon_size{ 72 };
     Orientation orientation{ Orientation::Horizontal };
-    fs::path definition_file{ "bar.json" };
-    BarConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>& screen);
+    fs::path config_dir;
+    fs::path definition_file{ "bar.json" };   // filename relative to config dir
+    bool oneshot{ false };                     // run in foreground, exit when window is closed
+    BarConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>& screen, const fs::path& config_dir);
 };
 
 class BarBox : public AppBox {
@@ -33,9 +35,20 @@ public:
     void on_activate() override;
 };
 
+struct BarEntry {
+    std::string name;
+    std::string exec;
+    std::string icon;
+    std::string css_class;
+    BarEntry(std::string, std::string, std::string);
+};
+
 class BarWindow : public PlatformWindow {
     public:
-        BarWindow(Config&);
+        BarWindow(BarConfig&);
+
+        // replaces the buttons, showing the fallback icon until the actual one is loaded
+        void set_entries(std::vector<BarEntry>&& entries, IconProvider& icon_provider);
 
         Gtk::ScrolledWindow scrolled_window;
         Gtk::VBox           outer_box;
@@ -43,6 +56,7 @@ class BarWindow : public PlatformWindow {
         Gtk::Grid           grid;            // Buttons grid
         Gtk::Separator      separator;       // between favs and all apps
         std::vector<BarBox> boxes {};        // attached to favs_grid
+        BarConfig&          config;
 
     private:
         //Override default signal handler:
@@ -50,15 +64,31 @@ class BarWindow : public PlatformWindow {
         bool on_key_press_event(GdkEventKey* event) override;
 };
 
-struct BarEntry {
-    std::string name;
-    std::string exec;
-    std::string icon;
-    std::string css_class;
-    BarEntry(std::string, std::string, std::string);
+struct BarInstance: public Instance {
+    BarWindow&                     window;
+    IconProvider&                  icon_provider;
+    Glib::RefPtr<Gtk::CssProvider> css_provider;
+    Glib::RefPtr<Gio::FileMonitor> template_monitor;
+    sigc::connection               template_reload; // pending reload of the changed template
+
+    BarInstance(Gtk::Application& app, std::string_view name, BarWindow& window, IconProvider& icon_provider,
+                const Glib::RefPtr<Gtk::CssProvider>& css_provider);
+    /* Instance on_* handlers call Application::quit
+     * which internally calls _exit, destructors are not called
+     * To handle this problem BarInstance overrides handlers
+     * to call Application::release
+     */
+    void on_sighup() override;  // reload the template & style
+    void on_sigint() override;  // exit
+    void on_sigterm() override; // exit
+    void on_sigusr1() override; // show
+    void reload_template();
 };
 
 /*
  * Function declarations
  * */
 std::vector<BarEntry> get_bar_entries(ns::json&&);
+// reads the template file set in `config`, falling back to the default one
+std::vector<BarEntry> load_bar_entries(const BarConfig& config);
+void load_bar_style(const Glib::RefPtr<Gtk::CssProvider>& provider, const BarConfig& config);
@@ -18,8 +18,9 @@
 #include "nwg_tools.h"
 #include "bar.h"
 
-BarConfig::BarConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>& screen):
-    Config{ parser, "~nwgbar", "~nwgbar", screen }
+BarConfig::BarConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>& screen, const fs::path& config_dir):
+    Config{ parser, "~nwgbar", "~nwgbar", screen },
+    config_dir{ config_dir }
 {
     if (parser.cmdOptionExists("-v")) {
         orientation = Orientation::Vertical;
@@ -30,9 +31,10 @@ BarConfig::BarConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>&
     if (auto i_size = parser.getCmdOption("-s"); !i_size.empty()) {
         icon_size = parse_icon_size(i_size);
     }
+    oneshot = parser.cmdOptionExists("-oneshot");
 }
 
-BarWindow::BarWindow(Config& config): PlatformWindow(config) {
+BarWindow::BarWindow(BarConfig& config): PlatformWindow(config), config{ config } {
     // scrolled_window -> outer_box -> inner_hbox -> grid
     grid.set_column_spacing(5);
     grid.set_row_spacing(5);
@@ -54,6 +56,43 @@ BarWindow::BarWindow(Config& config): PlatformWindow(config) {
     show_all_children();
 }
 
+void BarWindow::set_entries(std::vector<BarEntry>&& entries, IconProvider& icon_provider) {
+    for (auto && box: boxes) {
+        grid.remove(box);
+    }
+    boxes.clear();
+    // the boxes must not move once attached
+    boxes.reserve(entries.size());
+    for (auto& entry : entries) {
+        auto image = Gtk::make_managed<Gtk::Image>(icon_provider.fallback);
+        icon_provider.load_icon_async(entry.icon, *image);
+        auto& ab = boxes.emplace_back(std::move(entry.name),
+                                      std::move(entry.exec),
+                                      std::move(entry.icon));
+        ab.set_image_position(Gtk::POS_TOP);
+        ab.set_image(*image);
+        if (!entry.css_class.empty()) {
+            auto && style_context = ab.get_style_context();
+            style_context->add_class(entry.css_class);
+        }
+    }
+
+    int column = 0;
+    int row = 0;
+
+    grid.freeze_child_notify();
+    for (auto& box : boxes) {
+        grid.attach(box, column, row, 1, 1);
+        if (config.orientation == Orientation::Vertical) {
+            row++;
+        } else {
+            column++;
+        }
+    }
+    grid.thaw_child_notify();
+    show_all_children();
+}
+
 bool BarWindow::on_button_press_event(GdkEventButton* button) {
     (void)button;
     this->close();
@@ -95,3 +134,61 @@ void BarBox::on_activate() {
     }
     dynamic_cast<BarWindow*>(this->get_toplevel())->close();
 }
+
+BarInstance::BarInstance(Gtk::Application& app, std::string_view name, BarWindow& window,
+                         IconProvider& icon_provider, const Glib::RefPtr<Gtk::CssProvider>& css_provider):
+    Instance{ app, name },
+    window{ window },
+    icon_provider{ icon_provider },
+    css_provider{ css_provider }
+{
+    auto && config = window.config;
+    auto file = Gio::File::create_for_path(config.config_dir / config.definition_file);
+    template_monitor = file->monitor_file();
+    template_monitor->signal_changed().connect([this](auto&&, auto&&, auto event) {
+        switch (event) {
+            case Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+            case Gio::FILE_MONITOR_EVENT_CREATED:
+            case Gio::FILE_MONITOR_EVENT_DELETED:
+                break;
+            default:
+                return;
+        }
+        // an editor saving the file emits a few events in a row, reload once they are over
+        template_reload.disconnect();
+        template_reload = Glib::signal_timeout().connect(sigc::bind_return([this]() {
+            Log::info("Template file changed, reloading");
+            reload_template();
+        }, false), 100);
+    });
+}
+
+void BarInstance::reload_template() {
+    try {
+        window.set_entries(load_bar_entries(window.config), icon_provider);
+    } catch (const std::exception& e) {
+        Log::error("Failed to reload the template: ", e.what());
+    }
+}
+
+void BarInstance::on_sighup() {
+    template_reload.disconnect();
+    reload_template();
+    try {
+        load_bar_style(css_provider, window.config);
+    } catch (const Glib::Error& e) {
+        Log::error("Failed to reload the style: ", e.what());
+    }
+}
+
+void BarInstance::on_sigusr1() {
+    window.show(hint::Fullscreen);
+}
+
+void BarInstance::on_sigint() {
+    app.release();
+}
+
+void BarInstance::on_sigterm() {
+    app.release();
+}
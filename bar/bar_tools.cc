@@ -6,6 +6,7 @@
  * License: GPL3
  * */
 
+#include "nwg_tools.h"
 #include "bar.h"
 
 /*
@@ -26,3 +27,44 @@ std::vector<BarEntry> get_bar_entries(ns::json&& bar_json) {
     }
     return entries;
 }
+
+/*
+ * Returns the entries of the template set in `config`, falling back to the default one
+ * */
+std::vector<BarEntry> load_bar_entries(const BarConfig& config) {
+    // default or custom template
+    auto default_bar_file = config.config_dir / "bar.json";
+    auto custom_bar_file = config.config_dir / config.definition_file;
+    // copy default anyway if not found
+    if (!fs::exists(default_bar_file)) {
+        try {
+            fs::copy_file(DATA_DIR_STR "/nwgbar/bar.json", default_bar_file, fs::copy_options::overwrite_existing);
+        } catch (...) {
+            Log::error("Failed copying default template");
+        }
+    }
+
+    ns::json bar_json;
+    try {
+        bar_json = json_from_file(custom_bar_file);
+    }  catch (...) {
+        Log::error("Template file not found, using default");
+        bar_json = json_from_file(default_bar_file);
+    }
+    Log::info(bar_json.size(), " bar entries loaded");
+
+    std::vector<BarEntry> bar_entries {};
+    if (bar_json.size() > 0) {
+        bar_entries = get_bar_entries(std::move(bar_json));
+    }
+    return bar_entries;
+}
+
+/*
+ * (Re)loads the css file set in `config` to `provider`
+ * */
+void load_bar_style(const Glib::RefPtr<Gtk::CssProvider>& provider, const BarConfig& config) {
+    auto css_file = setup_css_file("nwgbar", config.config_dir, config.css_filename);
+    provider->load_from_path(css_file);
+    Log::info("Using css file \'", css_file, "\'");
+}
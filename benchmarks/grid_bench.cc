@@ -0,0 +1,364 @@
+/*
+ * Benchmarks of nwggrid entries loading & models
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "charconv-compat.h"
+#include "nwg_tools.h"
+#include "nwg_exceptions.h"
+#include "nwg_classes.h"
+#include "grid.h"
+#include "grid_entries.h"
+
+const char* const HELP_MESSAGE =
+"nwggrid-bench: benchmarks of nwggrid entries loading & models\n\n\
+Generates synthetic application dirs & times parsing, loading & filtering them.\n\
+The benchmarks requiring GTK are skipped if there is no display, use a virtual one on CI:\n\
+    xvfb-run -a nwggrid-bench\n\
+    GDK_BACKEND=broadway nwggrid-bench    (with broadwayd running)\n\n\
+Options:\n\
+-h               show this help message and exit\n\
+-n <n,n,...>     numbers of .desktop files to generate (default: 10,100,1000,10000)\n\
+-r <repeats>     number of runs of each benchmark, the best one is reported (default: 5)\n";
+
+/* Counts allocations made by the benchmarked code */
+namespace {
+    std::atomic<std::uint64_t> allocations{ 0 };
+}
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::string_view LANG = "pl";
+    constexpr int DIRS = 3; // priority dirs, the first one wins
+
+    /* Runs `f` `repeats` times, prints the best time, the throughput & allocations per item */
+    template <typename Setup, typename F>
+    void measure(std::string_view title, std::size_t items, int repeats, Setup && setup, F && f) {
+        auto best = Clock::duration::max();
+        std::uint64_t allocs = 0;
+        for (int i = 0; i < repeats; ++i) {
+            setup();
+            auto before = allocations.load();
+            auto start = Clock::now();
+            f();
+            auto time = Clock::now() - start;
+            if (time < best) {
+                best = time;
+                allocs = allocations.load() - before;
+            }
+        }
+        using namespace std::chrono;
+        auto us = duration_cast<duration<double, std::micro>>(best).count();
+        std::printf(
+            "  %-28.*s %12.1f us %14.0f items/s %10.1f allocs/item\n",
+            static_cast<int>(title.size()), title.data(),
+            us,
+            us > 0 ? items * 1e6 / us : 0.0,
+            items ? static_cast<double>(allocs) / items : 0.0
+        );
+    }
+    template <typename F>
+    void measure(std::string_view title, std::size_t items, int repeats, F && f) {
+        measure(title, items, repeats, []{}, std::forward<F>(f));
+    }
+
+    /* Synthetic application dirs:
+     * - every file has localized keys & a desktop action section
+     * - every 20th file is NoDisplay, every 7th runs in terminal
+     * - every 10th file goes to the first dir & overrides a file with the same id in the last one */
+    struct Tree {
+        fs::path                 root;
+        std::vector<fs::path>    dirs;
+        std::vector<fs::path>    files; // the winning ones
+        std::vector<std::string> ids;
+        std::vector<std::string> names;
+
+        Tree(const fs::path& root, std::size_t count): root{ root } {
+            for (int d = 0; d < DIRS; ++d) {
+                auto && dir = dirs.emplace_back(root / concat("applications-", std::to_string(d)));
+                fs::create_directories(dir);
+            }
+            std::mt19937 random{ static_cast<std::mt19937::result_type>(count) };
+            constexpr std::string_view syllables[] { "fi", "re", "fox", "ter", "mi", "nal", "ka", "te", "gim", "p", "vo", "lu", "me", "ed", "it", "or" };
+            for (std::size_t i = 0; i < count; ++i) {
+                std::string name;
+                for (int s = 2 + random() % 3; s > 0; --s) {
+                    name += syllables[random() % std::size(syllables)];
+                }
+                name[0] = name[0] - 'a' + 'A';
+                name += ' ';
+                name += std::to_string(i);
+                // spread the files between the dirs, lower priority dirs get more
+                auto dir = i % 10 == 0 ? 0 : 1 + i % (DIRS - 1);
+                auto id = concat("org.example.app", std::to_string(i), ".desktop");
+                write_file(dirs[dir] / id, name, i);
+                files.push_back(dirs[dir] / id);
+                if (dir == 0) {
+                    // the overridden file
+                    write_file(dirs[DIRS - 1] / id, concat("Old ", name), i);
+                }
+                ids.push_back(std::move(id));
+                names.push_back(std::move(name));
+            }
+        }
+        Tree(const Tree&) = delete;
+        ~Tree() {
+            std::error_code ec;
+            fs::remove_all(root, ec);
+        }
+
+        static void write_file(const fs::path& path, std::string_view name, std::size_t i) {
+            std::ofstream file{ path };
+            file << "[Desktop Entry]\n"
+                 << "Version=1.0\n"
+                 << "Type=Application\n"
+                 << "Name=" << name << '\n'
+                 << "Name[de]=" << name << " (de)\n"
+                 << "Name[" << LANG << "]=" << name << " (" << LANG << ")\n"
+                 << "GenericName=Example application\n"
+                 << "Comment=Does example things number " << i << '\n'
+                 << "Comment[" << LANG << "]=Robi przykładowe rzeczy numer " << i << '\n'
+                 << "Keywords=example;sample;test;\n"
+                 << "Keywords[" << LANG << "]=przykład;próbka;\n"
+                 << "Exec=/usr/bin/example-" << i << " --new-window %U\n"
+                 << "Icon=example-" << i % 50 << '\n'
+                 << "Terminal=" << (i % 7 == 0 ? "true" : "false") << '\n'
+                 << "Categories=Utility;Development;\n"
+                 << "MimeType=text/plain;text/html;application/xml;\n"
+                 << "StartupNotify=true\n";
+            if (i % 20 == 19) {
+                file << "NoDisplay=true\n";
+            }
+            file << "Actions=new;\n\n"
+                 << "[Desktop Action new]\n"
+                 << "Name=New window\n"
+                 << "Exec=/usr/bin/example-" << i << " --new\n";
+        }
+    };
+
+    void bench_parsing(const Tree& tree, int repeats) {
+        DesktopEntryConfig config{ LANG };
+        std::size_t ok = 0;
+        measure("on_desktop_entry", tree.files.size(), repeats, [&]() {
+            ok = 0;
+            for (auto && file: tree.files) {
+                on_desktop_entry(file, config, Overloaded {
+                    [&ok](std::unique_ptr<DesktopEntry>&&) { ++ok; },
+                    [](OnDesktopEntry::Hidden) { },
+                    [](OnDesktopEntry::Error) { }
+                });
+            }
+        });
+    }
+
+    void bench_favourites(const Tree& tree, int repeats) {
+        ns::json cache;
+        for (std::size_t i = 0; i < tree.files.size(); ++i) {
+            cache[tree.ids[i]] = static_cast<int>((i * 7919) % 1000);
+        }
+        measure("get_favourites", tree.files.size(), repeats, [&]() {
+            auto favs = get_favourites(ns::json{ cache }, 6);
+            (void)favs;
+        });
+    }
+
+    void bench_models(const Tree& tree, int repeats) {
+        Slab<Entry>   entries;
+        Slab<GridBox> boxes;
+        for (std::size_t i = 0; i < tree.names.size(); ++i) {
+            auto exec = concat("/usr/bin/example-", std::to_string(i));
+            auto comment = concat("Does example things number ", std::to_string(i));
+            DesktopEntry desktop_entry;
+            desktop_entry.name = tree.names[i];
+            desktop_entry.exec = exec;
+            desktop_entry.comment = comment;
+            desktop_entry.keywords = "example;sample;test;";
+            desktop_entry.pack();
+            auto && entry = *entries.get(entries.emplace(tree.ids[i], static_cast<DesktopIds::Slot>(i), Stats{}, std::move(desktop_entry)));
+            auto && box = *boxes.get(boxes.emplace(entry));
+            entry.box = &box;
+        }
+        Glib::RefPtr<AppBoxes> apps;
+        auto reset_apps = [&]() { apps = AppBoxes::create(); };
+        measure("AppBoxes::add", boxes.size(), repeats, reset_apps, [&]() {
+            for (auto && box: boxes) {
+                apps->add(box);
+            }
+        });
+        // typing a query char by char, then erasing it
+        std::vector<Glib::ustring> queries;
+        std::string query = "firefox";
+        for (std::size_t i = 1; i <= query.size(); ++i) {
+            queries.emplace_back(query.substr(0, i));
+        }
+        for (auto i = query.size() - 1; i > 0; --i) {
+            queries.emplace_back(query.substr(0, i));
+        }
+        queries.emplace_back("");
+        measure("AppBoxes::filter (typing)", boxes.size() * queries.size(), repeats, [&]() {
+            for (auto && q: queries) {
+                apps->filter(q);
+            }
+        });
+        Glib::RefPtr<FavBoxes> favs;
+        measure("FavBoxes::add", boxes.size(), repeats, [&]() { favs = FavBoxes::create(); }, [&]() {
+            for (auto && box: boxes) {
+                favs->add(box);
+            }
+        });
+        Glib::RefPtr<PinnedBoxes> pins;
+        measure("PinnedBoxes::add", boxes.size(), repeats, [&]() { pins = PinnedBoxes::create(); }, [&]() {
+            for (auto && box: boxes) {
+                pins->add(box);
+            }
+        });
+        // the models do not own the boxes
+        apps.reset();
+        favs.reset();
+        pins.reset();
+    }
+
+    void bench_loading(const Tree& tree, int repeats, const Glib::RefPtr<Gdk::Screen>& screen) {
+        std::string args[] { "nwggrid-bench", "-l", std::string{ LANG } };
+        char* argv[] { args[0].data(), args[1].data(), args[2].data() };
+        InputParser input{ static_cast<int>(std::size(argv)), argv };
+        GridConfig config{ input, screen, tree.root };
+        IconProvider icons{ Gtk::IconTheme::get_for_screen(screen), config.icon_size };
+        auto dirs = tree.dirs;
+        std::vector<std::string> pinned;
+        std::vector<CacheEntry>  favourites;
+        // only the entries loading is timed
+        std::optional<EntriesManager> manager;
+        std::optional<EntriesModel>   table;
+        std::optional<GridWindow>     window;
+        auto setup = [&](bool indexed) {
+            manager.reset();
+            table.reset();
+            window.reset();
+            if (!indexed) {
+                std::error_code ec;
+                fs::remove(config.index_file, ec);
+            }
+            window.emplace(config);
+            table.emplace(config, *window, icons, pinned, favourites);
+        };
+        auto run = [&]() {
+            manager.emplace(dirs, *table, config);
+        };
+        measure("EntriesManager (cold)", tree.files.size(), repeats, [&]() { setup(false); }, run);
+        measure("EntriesManager (indexed)", tree.files.size(), repeats, [&]() { setup(true); }, run);
+        manager.reset();
+        table.reset();
+        window.reset();
+        // let the icon jobs finish before the provider is gone
+        auto context = Glib::MainContext::get_default();
+        while (context->pending()) {
+            context->iteration(false);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        InputParser input{ argc, argv };
+        if (input.cmdOptionExists("-h")) {
+            std::cout << HELP_MESSAGE;
+            return EXIT_SUCCESS;
+        }
+        std::vector<std::size_t> sizes{ 10, 100, 1000, 10000 };
+        if (auto n = input.getCmdOption("-n"); !n.empty()) {
+            sizes.clear();
+            for (auto && item: split_string(n, ",")) {
+                std::size_t size;
+                if (!parse_number(item, size) || size == 0) {
+                    Log::error("Invalid number of files '", item, "'");
+                    return EXIT_FAILURE;
+                }
+                sizes.push_back(size);
+            }
+        }
+        int repeats = 5;
+        if (auto r = input.getCmdOption("-r"); !r.empty()) {
+            if (!parse_number(r, repeats) || repeats <= 0) {
+                Log::error("Invalid number of repeats '", r, "'");
+                return EXIT_FAILURE;
+            }
+        }
+
+        char root_template[] = "/tmp/nwggrid-bench-XXXXXX";
+        if (!mkdtemp(root_template)) {
+            int err = errno;
+            throw ErrnoException{ "failed to create temporary dir: ", err };
+        }
+        fs::path root{ root_template };
+        // keep the user's caches & config out of it
+        setenv("XDG_CACHE_HOME", (root / "cache").c_str(), 1);
+        setenv("TERMCMD", "xterm -e", 1);
+        fs::create_directories(root / "cache");
+
+        Glib::RefPtr<Gtk::Application> app;
+        Glib::RefPtr<Gdk::Screen>      screen;
+        if (gtk_init_check(&argc, &argv)) {
+            app = Gtk::Application::create();
+            if (auto display = Gdk::Display::get_default()) {
+                screen = display->get_default_screen();
+            }
+        }
+        if (!screen) {
+            Log::warn("No display, skipping the benchmarks requiring GTK");
+        }
+
+        for (auto size: sizes) {
+            Tree tree{ root / std::to_string(size), size };
+            std::printf("%zu .desktop files (+%zu overridden), %d dirs:\n", size, (size + 9) / 10, DIRS);
+            bench_parsing(tree, repeats);
+            bench_favourites(tree, repeats);
+            if (screen) {
+                bench_models(tree, repeats);
+                bench_loading(tree, repeats, screen);
+            }
+        }
+        std::error_code ec;
+        fs::remove_all(root, ec);
+        return EXIT_SUCCESS;
+    } catch (const Glib::Error& err) {
+        Log::error(err.what());
+    } catch (const std::exception& err) {
+        Log::error(err.what());
+    }
+    return EXIT_FAILURE;
+}
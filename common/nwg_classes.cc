@@ -12,14 +12,19 @@
 #include <unistd.h>
 #include <glib-unix.h>
 
+#include <sys/stat.h>
+
 #include <algorithm>
 #include <array>
+#include <cstdio>
+#include <ctime>
 #include <fstream>
 
 #include "charconv-compat.h"
 #include "nwgconfig.h"
 #include "nwg_classes.h"
 #include "nwg_exceptions.h"
+#include "nwg_pool.h"
 #include "nwg_tools.h"
 
 InputParser::InputParser (int argc, char **argv) {
@@ -153,6 +158,50 @@ AppBox::AppBox(Glib::ustring name, Glib::ustring exec, Glib::ustring comment):
     this -> set_always_show_image(true);
 }
 
+namespace {
+    template <typename Entry>
+    auto fields_of(Entry& entry) {
+        return std::array {
+            &entry.name, &entry.exec, &entry.icon, &entry.comment, &entry.mime_type, &entry.keywords,
+            &entry.try_exec, &entry.categories, &entry.only_show_in, &entry.not_show_in,
+            &entry.startup_wm_class, &entry.actions
+        };
+    }
+}
+
+DesktopEntry::DesktopEntry(const DesktopEntry& other) {
+    *this = other;
+}
+
+DesktopEntry& DesktopEntry::operator=(const DesktopEntry& other) {
+    if (this != &other) {
+        auto to = fields_of(*this);
+        auto from = fields_of(other);
+        for (std::size_t i = 0; i < to.size(); ++i) {
+            *to[i] = *from[i];
+        }
+        terminal = other.terminal;
+        pack();
+    }
+    return *this;
+}
+
+void DesktopEntry::pack() {
+    auto fields = fields_of(*this);
+    std::size_t size = 0;
+    for (auto* field: fields) {
+        size += field->size();
+    }
+    // the fields may point into the current block, it is released after they are copied
+    std::unique_ptr<char[]> block{ size > 0 ? new char[size] : nullptr };
+    auto* out = block.get();
+    for (auto* field: fields) {
+        out = std::copy(field->begin(), field->end(), out);
+        *field = std::string_view{ out - field->size(), field->size() };
+    }
+    storage = std::move(block);
+}
+
 Instance::Instance(Gtk::Application& app, std::string_view name): app{ app } {
     // TODO: maybe use dbus if it is present?
     pid_file = get_pid_file(name);
@@ -214,10 +263,237 @@ Instance::~Instance() {
     close(pid_lock_fd);
 }
 
+/*
+ * On-disk cache of rasterized icons: a file per (icon, size, resolved path), the path names the theme,
+ * named after the hash of the key and holding IconBlob header, the key and then packed pixel rows.
+ * The file is valid as long as the mtimes of the source file and of its theme's index.theme match.
+ * The cache is pruned by age & size, see prune_icon_cache
+ * Icons are always rendered at scale 1, so scale is not a part of the key
+ */
+namespace {
+    constexpr std::array<char, 8> ICON_BLOB_MAGIC { 'N', 'W', 'G', 'I', 'C', 'O', 'N', '\0' };
+    constexpr std::uint32_t       ICON_BLOB_VERSION = 1;
+    constexpr std::int64_t        ICON_CACHE_MAX_AGE = 30 * 24 * 60 * 60; // seconds
+    constexpr std::uint64_t       ICON_CACHE_MAX_SIZE = 64 << 20;          // bytes, ~1000 icons of 128x128
+
+    struct IconBlob {
+        std::array<char, 8> magic;
+        std::uint32_t       version;
+        std::uint32_t       key_size;
+        std::int64_t        source_mtime;
+        std::int64_t        theme_mtime;
+        std::int32_t        width;
+        std::int32_t        height;
+        std::int32_t        n_channels;
+        std::int32_t        padding_;
+    };
+
+    // returns file mtime in nanoseconds or 0 if it does not exist
+    std::int64_t file_mtime(const char* path) {
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            return 0;
+        }
+        return std::int64_t{ st.st_mtim.tv_sec } * 1'000'000'000 + st.st_mtim.tv_nsec;
+    }
+
+    // FNV-1a
+    std::string hash_of(std::string_view key) {
+        std::uint64_t hash = 14695981039346656037u;
+        for (unsigned char c: key) {
+            hash ^= c;
+            hash *= 1099511628211u;
+        }
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(hash));
+        return buf;
+    }
+
+    // everything needed to load the icon on the worker pool
+    struct IconJob {
+        std::string  icon;
+        std::string  path;          // resolved icon file
+        int          size;
+        fs::path     cache_file;    // empty if the cache is disabled
+        std::string  cache_key;
+        std::int64_t theme_mtime;
+    };
+
+    Glib::RefPtr<Gdk::Pixbuf> read_icon_blob(const IconJob& job, std::int64_t source_mtime) {
+        std::ifstream in{ job.cache_file, std::ios::binary };
+        IconBlob blob;
+        if (!in || !in.read(reinterpret_cast<char*>(&blob), sizeof(blob))) {
+            return {};
+        }
+        if (blob.magic != ICON_BLOB_MAGIC || blob.version != ICON_BLOB_VERSION
+            || blob.source_mtime != source_mtime || blob.theme_mtime != job.theme_mtime
+            || blob.key_size != job.cache_key.size()
+            || blob.width <= 0 || blob.height <= 0 || (blob.n_channels != 3 && blob.n_channels != 4)) {
+            return {};
+        }
+        std::string key(blob.key_size, '\0');
+        if (!in.read(key.data(), key.size()) || key != job.cache_key) {
+            return {};
+        }
+        auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, blob.n_channels == 4, 8, blob.width, blob.height);
+        auto* pixels = reinterpret_cast<char*>(pixbuf->get_pixels());
+        auto row_size = std::size_t(blob.width) * blob.n_channels;
+        auto rowstride = pixbuf->get_rowstride();
+        for (int y = 0; y < blob.height; ++y) {
+            if (!in.read(pixels + y * rowstride, row_size)) {
+                return {};
+            }
+        }
+        return pixbuf;
+    }
+
+    void write_icon_blob(const IconJob& job, std::int64_t source_mtime, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) {
+        if (pixbuf->get_colorspace() != Gdk::COLORSPACE_RGB || pixbuf->get_bits_per_sample() != 8) {
+            return;
+        }
+        IconBlob blob{
+            ICON_BLOB_MAGIC,
+            ICON_BLOB_VERSION,
+            static_cast<std::uint32_t>(job.cache_key.size()),
+            source_mtime,
+            job.theme_mtime,
+            pixbuf->get_width(),
+            pixbuf->get_height(),
+            pixbuf->get_n_channels(),
+            0
+        };
+        // other nwg-launchers may write the same icon concurrently
+        auto tmp_file = job.cache_file;
+        tmp_file += concat(".", std::to_string(getpid()));
+        {
+            std::ofstream out{ tmp_file, std::ios::binary | std::ios::trunc };
+            out.write(reinterpret_cast<const char*>(&blob), sizeof(blob));
+            out.write(job.cache_key.data(), job.cache_key.size());
+            auto* pixels = reinterpret_cast<const char*>(pixbuf->get_pixels());
+            auto row_size = std::size_t(blob.width) * blob.n_channels;
+            auto rowstride = pixbuf->get_rowstride();
+            for (int y = 0; y < blob.height; ++y) {
+                out.write(pixels + y * rowstride, row_size);
+            }
+            if (!out) {
+                Log::error("Failed to write icon cache file '", tmp_file, "'");
+                return;
+            }
+        }
+        std::error_code ec;
+        fs::rename(tmp_file, job.cache_file, ec);
+        if (ec) {
+            Log::error("Failed to save icon cache file '", job.cache_file, "': ", ec.message());
+            fs::remove(tmp_file, ec);
+        }
+    }
+
+    // called on the worker pool; returns null pixbuf on failure
+    Glib::RefPtr<Gdk::Pixbuf> load_pixbuf(const IconJob& job) {
+        auto source_mtime = file_mtime(job.path.c_str());
+        if (source_mtime == 0) {
+            Log::error("Failed to load icon '", job.icon, "': icon not found");
+            return {};
+        }
+        if (!job.cache_file.empty()) {
+            if (auto pixbuf = read_icon_blob(job, source_mtime)) {
+                return pixbuf;
+            }
+        }
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+        try {
+            pixbuf = Gdk::Pixbuf::create_from_file(job.path, job.size, job.size, true);
+        } catch (const Glib::Error& error) {
+            Log::error("Failed to load icon '", job.icon, "': ", error.what());
+            return {};
+        }
+        if (!job.cache_file.empty()) {
+            write_icon_blob(job, source_mtime, pixbuf);
+        }
+        return pixbuf;
+    }
+
+    // Blobs are never read again once the icon, the theme or the size change, as their key changes;
+    // drops the ones not written for ICON_CACHE_MAX_AGE (leftover temp files too),
+    // then the oldest ones until the rest fit in ICON_CACHE_MAX_SIZE.
+    // Runs on the worker pool; other nwg-launchers may prune the same dir concurrently, which is harmless
+    void prune_icon_cache(const fs::path& dir) {
+        struct Blob {
+            fs::path      path;
+            std::int64_t  mtime;
+            std::uint64_t size;
+        };
+        std::vector<Blob> blobs;
+        std::uint64_t total_size = 0;
+        auto oldest = (std::int64_t{ time(nullptr) } - ICON_CACHE_MAX_AGE) * 1'000'000'000;
+        std::error_code ec;
+        for (fs::directory_iterator iter{ dir, ec }, end; !ec && iter != end; iter.increment(ec)) {
+            struct stat st;
+            if (stat(iter->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+            auto mtime = std::int64_t{ st.st_mtim.tv_sec } * 1'000'000'000 + st.st_mtim.tv_nsec;
+            if (mtime < oldest) {
+                fs::remove(iter->path(), ec);
+                ec.clear();
+                continue;
+            }
+            blobs.push_back({ iter->path(), mtime, static_cast<std::uint64_t>(st.st_size) });
+            total_size += st.st_size;
+        }
+        if (total_size <= ICON_CACHE_MAX_SIZE) {
+            return;
+        }
+        std::sort(blobs.begin(), blobs.end(), [](auto && a, auto && b) { return a.mtime < b.mtime; });
+        for (auto && blob: blobs) {
+            if (total_size <= ICON_CACHE_MAX_SIZE) {
+                break;
+            }
+            fs::remove(blob.path, ec);
+            total_size -= blob.size;
+        }
+    }
+}
+
 IconProvider::IconProvider(const Glib::RefPtr<Gtk::IconTheme>& theme, int icon_size):
     icon_theme{ theme },
-    icon_size{ icon_size }
+    icon_size{ icon_size },
+    loaded{ std::make_shared<Loaded>() }
 {
+    loaded->dispatcher = &dispatcher;
+    dispatcher.connect(sigc::mem_fun(*this, &IconProvider::on_icons_loaded_));
+    load_fallback_();
+
+    clear_cache();
+    std::error_code ec;
+    cache_dir = get_cache_home() / "nwg-icons";
+    if (fs::create_directories(cache_dir, ec); ec) {
+        Log::error("Failed to create icon cache dir '", cache_dir, "': ", ec.message());
+        cache_dir.clear();
+        return;
+    }
+    ThreadPool::global().submit([dir=cache_dir]() { prune_icon_cache(dir); });
+}
+
+std::int64_t IconProvider::theme_mtime_(std::string_view path) {
+    for (auto && dir: search_path) {
+        if (path.size() <= dir.size() + 1 || path.compare(0, dir.size(), dir) != 0 || path[dir.size()] != '/') {
+            continue;
+        }
+        auto end = path.find('/', dir.size() + 1);
+        if (end == path.npos) {
+            return 0;
+        }
+        auto [iter, inserted] = theme_mtimes.try_emplace(std::string{ path.substr(0, end) }, 0);
+        if (inserted) {
+            iter->second = file_mtime(concat(iter->first, "/index.theme").c_str());
+        }
+        return iter->second;
+    }
+    return 0;
+}
+
+void IconProvider::load_fallback_() {
     constexpr std::array fallback_icons {
         DATA_DIR_STR "/icon-missing.svg",
         DATA_DIR_STR "/icon-missing.png"
@@ -240,26 +516,156 @@ IconProvider::IconProvider(const Glib::RefPtr<Gtk::IconTheme>& theme, int icon_s
     }
 }
 
-Gtk::Image IconProvider::load_icon(const std::string& icon) const {
+IconProvider::~IconProvider() {
+    std::lock_guard lock{ loaded->mutex };
+    loaded->dispatcher = nullptr;
+}
+
+Gtk::Image IconProvider::load_icon(const std::string& icon) {
     if (icon.empty()) {
         return Gtk::Image{ fallback };
     }
-    try {
-        if (icon.find_first_of("/") == icon.npos) {
-            return Gtk::Image{ icon_theme->load_icon(icon, icon_size, Gtk::ICON_LOOKUP_FORCE_SIZE) };
-        } else {
-            return Gtk::Image{ Gdk::Pixbuf::create_from_file(icon, icon_size, icon_size, true) };
+    if (auto iter = by_name.find(icon); iter != by_name.end()) {
+        return Gtk::Image{ iter->second };
+    }
+    auto load = [this,&icon]() {
+        try {
+            if (icon.find_first_of("/") == icon.npos) {
+                return icon_theme->load_icon(icon, icon_size, Gtk::ICON_LOOKUP_FORCE_SIZE);
+            } else {
+                return Gdk::Pixbuf::create_from_file(icon, icon_size, icon_size, true);
+            }
+        } catch (const Glib::Error& error) {
+            Log::error("Failed to load icon '", icon, "': ", error.what());
         }
-    } catch (const Glib::Error& error) {
-        Log::error("Failed to load icon '", icon, "': ", error.what());
+        try {
+            return Gdk::Pixbuf::create_from_file("/usr/share/pixmaps/" + icon, icon_size, icon_size, true);
+        } catch (const Glib::Error& error) {
+            Log::error("Failed to load icon '", icon, "': ", error.what());
+            Log::plain("falling back to placeholder");
+        }
+        return fallback;
+    };
+    return Gtk::Image{ by_name.emplace(icon, load()).first->second };
+}
+
+void IconProvider::clear_cache() {
+    // icons being loaded will still be delivered to their images
+    by_name.clear();
+    by_path.clear();
+    theme_mtimes.clear();
+    search_path.clear();
+    for (auto && dir: icon_theme->get_search_path()) {
+        std::string path{ dir };
+        while (path.size() > 1 && path.back() == '/') {
+            path.pop_back();
+        }
+        search_path.push_back(std::move(path));
     }
-    try {
-        return Gtk::Image{ Gdk::Pixbuf::create_from_file("/usr/share/pixmaps/" + icon, icon_size, icon_size, true) };
-    } catch (const Glib::Error& error) {
-        Log::error("Failed to load icon '", icon, "': ", error.what());
-        Log::plain("falling back to placeholder");
+}
+
+void IconProvider::set_icon_size(int size) {
+    if (size == icon_size) {
+        return;
+    }
+    icon_size = size;
+    load_fallback_();
+    clear_cache();
+}
+
+void IconProvider::load_icon_async(const std::string& icon, Gtk::Image& image) {
+    using SetPixbuf = void (Gtk::Image::*)(const Glib::RefPtr<Gdk::Pixbuf>&);
+    // the slot is invalidated when the image is destroyed
+    Slot slot = sigc::mem_fun(image, static_cast<SetPixbuf>(&Gtk::Image::set));
+    if (icon.empty()) {
+        slot(fallback);
+        return;
+    }
+    if (auto iter = by_name.find(icon); iter != by_name.end()) {
+        slot(iter->second);
+        return;
+    }
+    // resolve the icon path here, Gtk::IconTheme must not be used outside of the main thread
+    std::string path;
+    if (icon.find_first_of("/") != icon.npos) {
+        path = icon;
+    } else if (auto info = icon_theme->lookup_icon(icon, icon_size, Gtk::ICON_LOOKUP_FORCE_SIZE)) {
+        path = info.get_filename();
+        if (path.empty()) {
+            // builtin icons are not backed by files and are cheap to load
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+            try {
+                pixbuf = info.load_icon();
+            } catch (const Glib::Error& error) {
+                Log::error("Failed to load icon '", icon, "': ", error.what());
+                pixbuf = fallback;
+            }
+            by_name.emplace(icon, pixbuf);
+            slot(pixbuf);
+            return;
+        }
+    } else {
+        path = "/usr/share/pixmaps/" + icon;
+    }
+    // another icon name resolved to the same file
+    if (auto iter = by_path.find(path); iter != by_path.end()) {
+        by_name.emplace(icon, iter->second);
+        slot(iter->second);
+        return;
+    }
+    // the icon is being loaded already
+    if (auto iter = pending.find(path); iter != pending.end()) {
+        auto && names = iter->second.names;
+        if (std::find(names.begin(), names.end(), icon) == names.end()) {
+            names.push_back(icon);
+        }
+        iter->second.slots.push_back(std::move(slot));
+        return;
+    }
+    auto && waiting = pending[path];
+    waiting.names.push_back(icon);
+    waiting.slots.push_back(std::move(slot));
+
+    // the resolved path names the theme the icon comes from
+    IconJob job{ icon, std::move(path), icon_size, {}, {}, 0 };
+    if (!cache_dir.empty()) {
+        job.theme_mtime = theme_mtime_(job.path);
+        job.cache_key = concat(icon, '\n', std::to_string(icon_size), '\n', job.path);
+        job.cache_file = cache_dir / hash_of(job.cache_key);
+    }
+    ThreadPool::global().submit([loaded=loaded,job=std::move(job)]() {
+        auto pixbuf = load_pixbuf(job);
+        std::lock_guard lock{ loaded->mutex };
+        if (loaded->dispatcher) {
+            loaded->icons.emplace_back(job.path, std::move(pixbuf));
+            loaded->dispatcher->emit();
+        }
+    });
+}
+
+void IconProvider::on_icons_loaded_() {
+    decltype(loaded->icons) icons;
+    {
+        std::lock_guard lock{ loaded->mutex };
+        icons.swap(loaded->icons);
+    }
+    for (auto && [path, pixbuf]: icons) {
+        auto iter = pending.find(path);
+        if (iter == pending.end()) {
+            continue;
+        }
+        auto waiting = std::move(iter->second);
+        pending.erase(iter);
+        auto && result = pixbuf ? pixbuf : fallback;
+        by_path.emplace(path, result);
+        for (auto && name: waiting.names) {
+            by_name.emplace(std::move(name), result);
+        }
+        for (auto && slot: waiting.slots) {
+            slot(result);
+        }
     }
-    return Gtk::Image{ fallback };
+    icons_loaded.emit();
 }
 
 GenericShell::GenericShell(Config& config) {
@@ -12,7 +12,12 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 
@@ -129,13 +134,36 @@ struct Geometry {
     int height;
 };
 
+/*
+ * Fields of the [Desktop Entry] group.
+ * All strings of an entry live in one block it owns: point the fields at strings stored anywhere,
+ * then `pack` copies them into the block. Copies get a block of their own, moves take it along.
+ * */
 struct DesktopEntry {
-    std::string name;
-    std::string exec;
-    std::string icon;
-    std::string comment;
-    std::string mime_type;
-    bool terminal;
+    std::string_view name;
+    std::string_view exec;
+    std::string_view icon;
+    std::string_view comment;
+    std::string_view mime_type;
+    std::string_view keywords;
+    std::string_view try_exec;
+    std::string_view categories;       // ';'-separated, as the lists below
+    std::string_view only_show_in;
+    std::string_view not_show_in;
+    std::string_view startup_wm_class;
+    std::string_view actions;
+    bool terminal{ false };
+
+    DesktopEntry() = default;
+    DesktopEntry(const DesktopEntry& other);
+    DesktopEntry(DesktopEntry&&) = default;
+    DesktopEntry& operator=(const DesktopEntry& other);
+    DesktopEntry& operator=(DesktopEntry&&) = default;
+
+    // copies the strings the fields point to into a new block, replacing the previous one
+    void pack();
+private:
+    std::unique_ptr<char[]> storage;
 };
 
 struct Instance {
@@ -153,15 +181,71 @@ struct Instance {
     virtual void on_sigint();
 };
 
+/* Base class for application drivers, simply calls Application::run */
+struct ApplicationDriver {
+    Glib::RefPtr<Gtk::Application> app;
+
+    ApplicationDriver(const Glib::RefPtr<Gtk::Application>& app): app{ app } {
+        // intentionally left blank
+    }
+    virtual ~ApplicationDriver() = default;
+    virtual int run() { return app->run(); }
+};
+
 struct IconProvider {
     Glib::RefPtr<Gtk::IconTheme> icon_theme;
     Glib::RefPtr<Gdk::Pixbuf>    fallback;
     int                          icon_size;
+    // rasterized icons from the previous runs, see load_icon_async
+    fs::path                     cache_dir;   // empty if the cache is disabled
 
     IconProvider(const Glib::RefPtr<Gtk::IconTheme>& theme, int icon_size);
+    ~IconProvider();
     // Returns Gtk::Image out of the icon name of file path
     // the returned image is scaled to icon_size x icon_size
-    Gtk::Image load_icon(const std::string& icon) const;
+    Gtk::Image load_icon(const std::string& icon);
+    // Decodes the icon on the worker pool and sets it to `image` on the main thread
+    // (or sets `fallback` if the icon can't be loaded). Nothing happens if `image` is destroyed by then.
+    // Icons are decoded in the order they are requested, so request the visible ones first.
+    // Decoded icons are cached on disk, so SVGs are only rendered when the icon, the theme
+    // or the size change
+    // Loaded icons are shared between all images showing them, by icon name and by resolved file,
+    // so the same icon is decoded (and kept in memory) once
+    void load_icon_async(const std::string& icon, Gtk::Image& image);
+    // forgets the loaded icons, e.g. when the icon theme changes
+    void clear_cache();
+    // reloads the fallback icon & forgets the loaded icons
+    void set_icon_size(int size);
+    // emitted on the main thread after a batch of decoded icons is set to the images
+    sigc::signal<void>& signal_icons_loaded() { return icons_loaded; }
+private:
+    using Slot = sigc::slot<void, const Glib::RefPtr<Gdk::Pixbuf>&>;
+    // shared with the jobs on the pool, which can outlive IconProvider
+    struct Loaded {
+        std::mutex                                                    mutex;
+        Glib::Dispatcher*                                             dispatcher; // null when IconProvider is gone
+        std::vector<std::pair<std::string, Glib::RefPtr<Gdk::Pixbuf>>> icons;      // by path, null pixbuf means failure
+    };
+    // icon being loaded on the pool
+    struct Pending {
+        std::vector<std::string> names; // icon names resolved to the path
+        std::vector<Slot>        slots;
+    };
+    Glib::Dispatcher                                           dispatcher;
+    sigc::signal<void>                                         icons_loaded;
+    std::shared_ptr<Loaded>                                    loaded;
+    std::unordered_map<std::string, Pending>                   pending; // by resolved path
+    // loaded icons, the ones failed to load are mapped to `fallback`
+    std::unordered_map<std::string, Glib::RefPtr<Gdk::Pixbuf>> by_name;
+    std::unordered_map<std::string, Glib::RefPtr<Gdk::Pixbuf>> by_path;
+    // the cached icons are invalidated when index.theme of their theme changes
+    std::vector<std::string>                                   search_path; // of icon_theme
+    std::unordered_map<std::string, std::int64_t>              theme_mtimes; // by theme dir
+
+    void on_icons_loaded_();
+    void load_fallback_();
+    // mtime of index.theme of the theme `path` is part of, 0 if it is not in the search path
+    std::int64_t theme_mtime_(std::string_view path);
 };
 
 enum class SwayError {
@@ -0,0 +1,61 @@
+/*
+ * Thread pool for nwg-launchers
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include "nwg_pool.h"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this]() { work_(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{ mutex };
+        stop = true;
+        jobs.clear();
+    }
+    cv.notify_all();
+    for (auto && worker: workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard lock{ mutex };
+        jobs.emplace_back(std::move(job));
+    }
+    cv.notify_one();
+}
+
+void ThreadPool::work_() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{ mutex };
+            cv.wait(lock, [this]() { return stop || !jobs.empty(); });
+            if (stop) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
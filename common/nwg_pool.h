@@ -0,0 +1,110 @@
+/*
+ * Thread pool for nwg-launchers
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed-size pool of worker threads executing jobs in FIFO order.
+ * Jobs must not touch Gtk objects; pass the results back to the main loop
+ * (e.g. via Glib::Dispatcher) instead.
+ */
+class ThreadPool {
+public:
+    // `threads` == 0 means one thread per core
+    explicit ThreadPool(unsigned threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    // waits for the running jobs, the queued ones are dropped
+    ~ThreadPool();
+
+    // process-wide pool, created on first use
+    static ThreadPool& global();
+
+    void submit(std::function<void()> job);
+    // calls f(i) for each i in [0, n) using the workers and the calling thread,
+    // returns when all calls are finished, rethrows the first exception thrown by f
+    template <typename F>
+    void parallel_for(std::size_t n, F && f);
+
+    std::size_t size() const { return workers.size(); }
+private:
+    std::vector<std::thread>          workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex                        mutex;
+    std::condition_variable           cv;
+    bool                              stop{ false };
+
+    void work_();
+};
+
+template <typename F>
+void ThreadPool::parallel_for(std::size_t n, F && f) {
+    if (n == 0) {
+        return;
+    }
+    // helpers may start after parallel_for has returned,
+    // so the shared state is refcounted and `f` is only touched while there is work left
+    struct State {
+        std::atomic<std::size_t> next{ 0 };
+        std::size_t              done{ 0 };
+        std::size_t              n;
+        std::exception_ptr       error;
+        std::mutex               mutex;
+        std::condition_variable  cv;
+        std::function<void(std::size_t)> f;
+    };
+    auto state = std::make_shared<State>();
+    state->n = n;
+    state->f = std::ref(f);
+    auto run = [](State& s) {
+        std::size_t i, count{ 0 };
+        std::exception_ptr error;
+        while ((i = s.next.fetch_add(1)) < s.n) {
+            try {
+                s.f(i);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            ++count;
+        }
+        if (count > 0) {
+            std::lock_guard lock{ s.mutex };
+            if (error && !s.error) {
+                s.error = error;
+            }
+            s.done += count;
+            if (s.done == s.n) {
+                s.cv.notify_all();
+            }
+        }
+    };
+    auto helpers = std::min(workers.size(), n - 1);
+    for (std::size_t h = 0; h < helpers; ++h) {
+        submit([state,run]() { run(*state); });
+    }
+    run(*state);
+    std::unique_lock lock{ state->mutex };
+    state->cv.wait(lock, [&s=*state]() { return s.done == s.n; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
@@ -0,0 +1,212 @@
+/*
+ * Unix sockets for nwg-launchers
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cstring>
+#include <utility>
+
+#include "nwg_exceptions.h"
+#include "nwg_tools.h"
+#include "nwg_socket.h"
+
+namespace {
+    sockaddr_un socket_address(const fs::path& path) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        auto && native = path.native();
+        if (native.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error{ concat("socket path is too long: ", native) };
+        }
+        std::memcpy(addr.sun_path, native.c_str(), native.size() + 1);
+        return addr;
+    }
+}
+
+SocketConnection::SocketConnection(SocketConnection&& other): fd{ std::exchange(other.fd, -1) } {
+    // intentionally left blank
+}
+
+SocketConnection& SocketConnection::operator=(SocketConnection&& other) {
+    if (this != &other) {
+        close();
+        fd = std::exchange(other.fd, -1);
+    }
+    return *this;
+}
+
+SocketConnection::~SocketConnection() {
+    close();
+}
+
+void SocketConnection::close() {
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void SocketConnection::send(std::string_view message, const std::vector<int>& fds) {
+    if (fds.size() > MAX_FDS) {
+        throw std::logic_error{ "too many descriptors to send" };
+    }
+    iovec iov{ const_cast<char*>(message.data()), message.size() };
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    if (!fds.empty()) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        auto* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+    while (sendmsg(fd, &msg, MSG_NOSIGNAL) == -1) {
+        int err = errno;
+        if (err != EINTR) {
+            throw ErrnoException{ "failed to send message: ", err };
+        }
+    }
+}
+
+bool SocketConnection::receive(std::string& message, std::vector<int>& fds) {
+    message.resize(MAX_MESSAGE_SIZE);
+    iovec iov{ message.data(), message.size() };
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    while ((n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) == -1) {
+        int err = errno;
+        if (err != EINTR) {
+            message.clear();
+            throw ErrnoException{ "failed to receive message: ", err };
+        }
+    }
+    message.resize(n);
+    for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            auto first = fds.size();
+            fds.resize(first + count);
+            std::memcpy(fds.data() + first, CMSG_DATA(cmsg), sizeof(int) * count);
+        }
+    }
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        throw std::runtime_error{ "received message is too long" };
+    }
+    // zero-sized messages are never sent, so this is the end of the stream
+    return n > 0;
+}
+
+SocketConnection connect_socket(const fs::path& path) {
+    auto addr = socket_address(path);
+    SocketConnection connection{ socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0) };
+    if (!connection) {
+        int err = errno;
+        throw ErrnoException{ "failed to create socket: ", err };
+    }
+    if (connect(connection.native(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        int err = errno;
+        throw ErrnoException{ "failed to connect: ", err };
+    }
+    return connection;
+}
+
+SocketServer::Request::~Request() {
+    for (auto fd: fds) {
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+}
+
+SocketServer::SocketServer(fs::path path_, Handler on_request):
+    path{ std::move(path_) },
+    on_request{ std::move(on_request) }
+{
+    auto addr = socket_address(path);
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        int err = errno;
+        throw ErrnoException{ "failed to create socket: ", err };
+    }
+    // the previous instance is gone, but it might have failed to remove the socket
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(fd, 16) == -1) {
+        int err = errno;
+        ::close(fd);
+        throw ErrnoException{ concat("failed to listen on '", path.native(), "': "), err };
+    }
+    watch = Glib::signal_io().connect(sigc::mem_fun(*this, &SocketServer::on_accept_), fd, Glib::IO_IN);
+}
+
+SocketServer::~SocketServer() {
+    watch.disconnect();
+    for (auto && item: pending) {
+        item.watch.disconnect();
+    }
+    ::close(fd);
+    if (std::error_code ec; !fs::remove(path, ec) && ec) {
+        Log::error("Failed to remove socket '", path, "': ", ec.message());
+    }
+}
+
+bool SocketServer::on_accept_(Glib::IOCondition) {
+    for (;;) {
+        auto connection_fd = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (connection_fd == -1) {
+            int err = errno;
+            if (err != EAGAIN && err != EWOULDBLOCK && err != EINTR && err != ECONNABORTED) {
+                Log::error("Failed to accept connection: ", error_description(err));
+            }
+            if (err == EINTR || err == ECONNABORTED) {
+                continue;
+            }
+            return true;
+        }
+        // don't block the main loop waiting for the request
+        auto iter = pending.insert(pending.end(), Pending{ SocketConnection{ connection_fd }, {} });
+        iter->watch = Glib::signal_io().connect(
+            [this,iter](Glib::IOCondition condition) { return on_message_(iter, condition); },
+            connection_fd,
+            Glib::IO_IN | Glib::IO_HUP | Glib::IO_ERR
+        );
+    }
+}
+
+bool SocketServer::on_message_(std::list<Pending>::iterator iter, Glib::IOCondition) {
+    Request request;
+    try {
+        if (!iter->connection.receive(request.message, request.fds)) {
+            pending.erase(iter);
+            return false;
+        }
+    } catch (const std::exception& e) {
+        Log::error("Failed to read request: ", e.what());
+        pending.erase(iter);
+        return false;
+    }
+    request.connection = std::move(iter->connection);
+    pending.erase(iter);
+    // replies are small, there is no point in making the handler deal with EAGAIN
+    auto flags = fcntl(request.connection.native(), F_GETFL);
+    fcntl(request.connection.native(), F_SETFL, flags & ~O_NONBLOCK);
+    on_request(request);
+    return false;
+}
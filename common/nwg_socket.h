@@ -0,0 +1,94 @@
+/*
+ * Unix sockets for nwg-launchers
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glibmm/main.h>
+
+#include "filesystem-compat.h"
+
+/*
+ * Servers & clients talk over SOCK_SEQPACKET unix sockets, so each send is received as a whole message.
+ * A client sends a request message, possibly carrying file descriptors (e.g. its stdin),
+ * and receives zero or more reply messages until the server closes the connection.
+ */
+
+// owns a connected socket
+class SocketConnection {
+public:
+    // the largest message receive can handle
+    static constexpr std::size_t MAX_MESSAGE_SIZE = 64 * 1024;
+    // the largest number of descriptors that can be passed with a message
+    static constexpr std::size_t MAX_FDS = 4;
+
+    SocketConnection() = default;
+    explicit SocketConnection(int fd): fd{ fd } {
+        // intentionally left blank
+    }
+    SocketConnection(SocketConnection&& other);
+    SocketConnection& operator=(SocketConnection&& other);
+    ~SocketConnection();
+
+    explicit operator bool() const { return fd != -1; }
+    int native() const { return fd; }
+    // sends `message` along with `fds`, throws ErrnoException
+    void send(std::string_view message, const std::vector<int>& fds = {});
+    // receives a message to `message`, the descriptors passed with it are appended to `fds`;
+    // returns false if the peer has closed the connection, throws ErrnoException
+    bool receive(std::string& message, std::vector<int>& fds);
+    void close();
+private:
+    int fd{ -1 };
+};
+
+// connects to the socket at `path`, throws ErrnoException
+SocketConnection connect_socket(const fs::path& path);
+
+/*
+ * Listens on the socket at `path`, replacing the stale one if any (the caller is supposed to be
+ * the only instance, see Instance). Accepts connections on the main loop and passes the first message
+ * of each one to `on_request`, which can keep the connection to reply later
+ */
+class SocketServer {
+public:
+    struct Request {
+        SocketConnection connection;
+        std::string      message;
+        std::vector<int> fds; // received descriptors, the ones left here are closed with the request
+
+        Request() = default;
+        Request(const Request&) = delete;
+        ~Request();
+    };
+    using Handler = std::function<void(Request&)>;
+
+    SocketServer(fs::path path, Handler on_request);
+    SocketServer(const SocketServer&) = delete;
+    ~SocketServer();
+private:
+    // accepted connection, which has not sent the request yet
+    struct Pending {
+        SocketConnection connection;
+        sigc::connection watch;
+    };
+    fs::path           path;
+    int                fd{ -1 };
+    Handler            on_request;
+    sigc::connection   watch;
+    std::list<Pending> pending;
+
+    bool on_accept_(Glib::IOCondition condition);
+    bool on_message_(std::list<Pending>::iterator iter, Glib::IOCondition condition);
+};
@@ -0,0 +1,135 @@
+/*
+ * Latency tracing for nwg-launchers
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include "nwg_trace.h"
+
+#ifdef NWG_TRACING
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string_view>
+
+#include "nwg_tools.h"
+
+namespace {
+    /* Microsecond histogram; each power of two range is split into SUB buckets,
+     * so the reported percentiles are within 25% of the real ones */
+    class Histogram {
+    public:
+        void add(std::uint64_t us) {
+            ++buckets[index(us)];
+            ++count;
+            max = std::max(max, us);
+        }
+        // upper bound of the bucket holding the `p`-th quantile, `p` in (0, 1]
+        std::uint64_t quantile(double p) const {
+            auto target = static_cast<std::uint64_t>(p * count + 0.5);
+            target = std::max<std::uint64_t>(target, 1);
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                seen += buckets[i];
+                if (seen >= target) {
+                    return std::min(max, lower_bound(i + 1) - 1);
+                }
+            }
+            return max;
+        }
+        std::uint64_t samples() const { return count; }
+        std::uint64_t maximum() const { return max; }
+    private:
+        static constexpr unsigned SUB_BITS = 2;
+        static constexpr std::uint64_t SUB = 1 << SUB_BITS;
+
+        std::array<std::uint64_t, 64 * SUB> buckets{};
+        std::uint64_t                       count{ 0 };
+        std::uint64_t                       max{ 0 };
+
+        static unsigned log2(std::uint64_t value) {
+            return 63 - __builtin_clzll(value);
+        }
+        static std::size_t index(std::uint64_t us) {
+            if (us < SUB) {
+                return us;
+            }
+            auto e = log2(us);
+            return (e - SUB_BITS + 1) * SUB + ((us >> (e - SUB_BITS)) & (SUB - 1));
+        }
+        // the smallest value stored in the bucket `i`
+        static std::uint64_t lower_bound(std::size_t i) {
+            if (i < SUB) {
+                return i;
+            }
+            auto e = i / SUB + SUB_BITS - 1;
+            if (e >= 64) {
+                return UINT64_MAX;
+            }
+            return (SUB + i % SUB) << (e - SUB_BITS);
+        }
+    };
+
+    struct Registry {
+        std::mutex                                    mutex;
+        std::map<std::string, Histogram, std::less<>> histograms;
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+}
+
+namespace Trace {
+    void record(const char* stage, Clock::duration duration) {
+        using namespace std::chrono;
+        auto us = duration_cast<microseconds>(duration).count();
+        auto& r = registry();
+        std::lock_guard lock{ r.mutex };
+        auto iter = r.histograms.find(std::string_view{ stage });
+        if (iter == r.histograms.end()) {
+            iter = r.histograms.emplace(stage, Histogram{}).first;
+        }
+        iter->second.add(us > 0 ? static_cast<std::uint64_t>(us) : 0);
+    }
+
+    std::string report() {
+        auto& r = registry();
+        std::lock_guard lock{ r.mutex };
+        std::string result;
+        for (auto && [stage, histogram]: r.histograms) {
+            result += concat(
+                stage,
+                " count=", std::to_string(histogram.samples()),
+                " p50=", std::to_string(histogram.quantile(0.5)), "us",
+                " p99=", std::to_string(histogram.quantile(0.99)), "us",
+                " max=", std::to_string(histogram.maximum()), "us\n"
+            );
+        }
+        return result;
+    }
+
+    void dump(const fs::path& path) {
+        auto text = report();
+        if (text.empty()) {
+            return;
+        }
+        std::ofstream file{ path };
+        file << text;
+        if (!file) {
+            Log::error("Failed to write trace to '", path, "'");
+        } else {
+            Log::info("Trace written to '", path, "'");
+        }
+    }
+}
+
+#endif
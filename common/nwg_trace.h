@@ -0,0 +1,102 @@
+/*
+ * Latency tracing for nwg-launchers
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "filesystem-compat.h"
+
+/*
+ * Enabled with `meson -Dtracing=true`, which defines NWG_TRACING; otherwise everything here is a no-op.
+ * Durations are recorded, per stage, to log-linear histograms kept for the lifetime of the process.
+ * Stages are named by string literals.
+ */
+namespace Trace {
+    using Clock = std::chrono::steady_clock;
+
+#ifdef NWG_TRACING
+    constexpr bool enabled = true;
+
+    // adds `duration` to the histogram of `stage`, thread-safe
+    void record(const char* stage, Clock::duration duration);
+    // sample count, p50, p99 & max of each stage, one per line
+    std::string report();
+    // writes the report to `path`
+    void dump(const fs::path& path);
+
+    /* Records the time from construction to destruction */
+    class Span {
+    public:
+        explicit Span(const char* stage): stage{ stage }, begin{ Clock::now() } {
+            // intentionally left blank
+        }
+        Span(const Span&) = delete;
+        ~Span() {
+            record(stage, Clock::now() - begin);
+        }
+    private:
+        const char*       stage;
+        Clock::time_point begin;
+    };
+
+    /* Records the time from `start` to the marked stages, which may happen in later main loop iterations.
+     * Each stage is recorded once per start */
+    class Timeline {
+    public:
+        // does nothing if already started
+        void start() {
+            if (!running) {
+                running = true;
+                begin = Clock::now();
+                reached.clear();
+            }
+        }
+        void mark(const char* stage) {
+            if (!running) {
+                return;
+            }
+            for (auto* s: reached) {
+                if (s == stage) {
+                    return;
+                }
+            }
+            reached.push_back(stage);
+            record(stage, Clock::now() - begin);
+        }
+        void stop() {
+            running = false;
+        }
+    private:
+        Clock::time_point        begin;
+        std::vector<const char*> reached;
+        bool                     running{ false };
+    };
+#else
+    constexpr bool enabled = false;
+
+    inline void record(const char*, Clock::duration) { }
+    inline std::string report() { return {}; }
+    inline void dump(const fs::path&) { }
+
+    class Span {
+    public:
+        explicit Span(const char*) { }
+    };
+
+    class Timeline {
+    public:
+        void start() { }
+        void mark(const char*) { }
+        void stop() { }
+    };
+#endif
+}
@@ -7,8 +7,12 @@
  * License: GPL3
  * */
 
+#include <unistd.h>
+
 #include <iostream>
 
+#include "nwg_exceptions.h"
+#include "nwg_socket.h"
 #include "nwg_tools.h"
 #include "nwg_classes.h"
 #include "dmenu.h"
@@ -31,7 +35,10 @@ Options:\n\
 -b <background>  background colour in RRGGBB or RRGGBBAA format (RRGGBBAA alpha overrides <opacity>)\n\
 -g <theme>       GTK theme name\n\
 -wm <wmname>     window manager name (if can not be detected)\n\
--run             ignore stdin, always build from commands in $PATH\n\n\
+-run             ignore stdin, always build from commands in $PATH\n\
+-client [ARGS]   show the menu of running nwgdmenu-server instead, passing it stdin & ARGS;\n\
+                 the selected line is printed unless the menu shows $PATH commands\n\
+                 (the server only takes -run & -r from ARGS, other options are set by nwgdmenu-server)\n\n\
 [requires layer-shell]:\n\
 -layer-shell-layer          {BACKGROUND,BOTTOM,TOP,OVERLAY},        default: OVERLAY\n\
 -layer-shell-exclusive-zone {auto, valid integer (usually -1 or 0)}, default: auto\n\n\
@@ -39,8 +46,50 @@ Hotkeys:\n\
 Delete        clear search box\n\
 Insert        switch case sensitivity\n";
 
+/*
+ * Shows the menu of nwgdmenu-server, argv[1] is "-client"
+ * */
+static int run_client(int argc, char* argv[]) {
+    // the request is the arguments, each terminated by '\0', starting with the program name
+    std::string request;
+    for (int i = 1; i < argc; ++i) {
+        request += i == 1 ? "nwgdmenu" : argv[i];
+        request += '\0';
+    }
+    InputParser input{ argc - 1, argv + 1 };
+    // the server decides the same way
+    auto dmenu_run = input.cmdOptionExists("-run") || isatty(STDIN_FILENO) == 1;
+
+    SocketConnection connection;
+    try {
+        connection = connect_socket(get_socket_path());
+    } catch (const std::exception& e) {
+        throw std::runtime_error{ concat("nwgdmenu-server is not running: ", e.what()) };
+    }
+    std::vector<int> fds;
+    if (!dmenu_run) {
+        fds.push_back(STDIN_FILENO);
+    }
+    connection.send(request, fds);
+
+    // the reply is the selected line followed by '\n', the connection is closed if nothing was selected
+    std::string reply;
+    std::vector<int> reply_fds;
+    if (!connection.receive(reply, reply_fds)) {
+        return EXIT_FAILURE;
+    }
+    if (!dmenu_run) {
+        std::cout << reply << std::flush;
+    }
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
     try {
+        using namespace std::string_view_literals;
+        if (argc >= 2 && argv[1] == "-client"sv) {
+            return run_client(argc, argv);
+        }
 
         InputParser input(argc, argv);
         if (input.cmdOptionExists("-h")){
@@ -80,20 +129,22 @@ int main(int argc, char *argv[]) {
             provider->load_from_path(css_file);
         }
 
-        auto all_commands = get_commands_list(config);
-        DmenuWindow window{ config, all_commands };
+        DmenuWindow window{ config, config.dmenu_run ? get_commands_list() : LineStore{} };
         window.set_background_color(background_color);
         window.show_all_children();
-        switch (2 * (config.valign == VAlign::NotSpecified) + (config.halign == HAlign::NotSpecified )) {
-            case 0:
-                window.show(hint::Sides{ { config.halign == HAlign::Right, 50 }, { config.valign == VAlign::Bottom, 50 } }); break;
-            case 1:
-                window.show(hint::Side<hint::Vertical>{ config.valign == VAlign::Bottom, 50 }); break;
-            case 2:
-                window.show(hint::Side<hint::Horizontal>{ config.halign == HAlign::Right, 50 }); break;
-            case 3:
-                window.show(hint::Center); break;
+        int input_fd = -1;
+        if (!config.dmenu_run) {
+            input_fd = dup(STDIN_FILENO);
+            if (input_fd == -1) {
+                int err = errno;
+                throw ErrnoException{ "failed to dup stdin: ", err };
+            }
         }
+        window.show_menu(input_fd, [](const Glib::ustring* selection) {
+            if (selection) {
+                run_command(*selection);
+            }
+        });
         return app->run(window);
     } catch (const Glib::FileError& error) {
         Log::error(error.what());
@@ -7,6 +7,12 @@
  * */
 
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include <gtkmm.h>
@@ -22,6 +28,9 @@
 
 struct DmenuConfig: public Config {
     DmenuConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>& screen);
+    // sets the options which may differ between the menus shown by one process (mode & rows),
+    // `input_fd` is the descriptor the lines are read from, or -1 if there is none
+    void set_menu_options(const InputParser& parser, int input_fd);
 
     fs::path settings_file;
     int rows{ ROWS_DEFAULT };            // number of menu items to display
@@ -30,15 +39,139 @@ struct DmenuConfig: public Config {
     bool case_sensitive{ true };
 };
 
+/* Lines stored back to back in a few shared buffers rather than in a string each.
+ * The buffers are either chunks filled by push_back, or external memory added with add_buffer
+ * (e.g. mmap'ed stdin); Glib::ustring is only created for the lines actually displayed */
+class LineStore {
+public:
+    using Buffer = std::shared_ptr<const char[]>;
+
+    std::size_t size() const { return lines.size(); }
+    bool empty() const { return lines.empty(); }
+    std::string_view operator[](std::size_t i) const { return lines[i]; }
+    auto begin() { return lines.begin(); }
+    auto end() { return lines.end(); }
+
+    // copies `line` into the store
+    void push_back(std::string_view line);
+    // keeps `buffer` alive as long as the store, so that lines pointing to it can be added
+    void add_buffer(Buffer buffer);
+    void add_line(std::string_view line) { lines.push_back(line); }
+    // moves the lines & buffers of `other` to the end of the store
+    void append(LineStore&& other);
+private:
+    std::vector<Buffer>           buffers;
+    std::vector<std::string_view> lines;
+    char*                         free_space{ nullptr }; // unused tail of the last chunk
+    std::size_t                   free_size{ 0 };
+};
+
+/* Reads stdin (or the client's stdin passed to the server) on a separate thread,
+ * so that the window shows up before the input ends. Takes the ownership of `fd`.
+ * The lines are passed to `on_lines` on the main thread in batches, the last batch has `eof` set */
+class StdinReader {
+public:
+    using Slot = sigc::slot<void, LineStore&, bool>;
+    StdinReader(int fd, Slot on_lines);
+    StdinReader(const StdinReader&) = delete;
+    ~StdinReader();
+
+    bool eof() const { return eof_; }
+private:
+    // shared with the reader thread, which is detached as it may block on read(2) forever
+    struct Shared {
+        std::mutex                 mutex;
+        Glib::Dispatcher*          dispatcher; // null when StdinReader is gone
+        LineStore                  lines;
+        bool                       eof{ false };
+    };
+    Glib::Dispatcher        dispatcher;
+    std::shared_ptr<Shared> shared;
+    Slot                    on_lines;
+    bool                    eof_{ false };
+
+    void on_dispatch_();
+};
+
+/* Finds the lines to show: first `rows` lines starting with the phrase, then the lines containing it,
+ * in the source order. Large sources are split into chunks filtered on the thread pool in parallel;
+ * only one run is in flight at a time, a newer request cancels it and starts when it is finished */
+class DmenuFilter {
+public:
+    // sources smaller than this are filtered on the main thread
+    static constexpr std::size_t PARALLEL_THRESHOLD = 64 * 1024;
+
+    struct Request {
+        std::string phrase;         // casefolded unless case_sensitive
+        bool        case_sensitive;
+        std::size_t rows;
+    };
+    struct Result {
+        std::vector<std::size_t> lines;       // indices of the lines to show
+        std::size_t              exact;       // number of prefix matches among them
+        std::size_t              source_size; // number of lines filtered
+    };
+    // called when the filter becomes idle, with the result of the last request or null if it was cancelled
+    using Slot = sigc::slot<void, const Result*>;
+
+    DmenuFilter(const LineStore& source, Slot on_idle);
+    DmenuFilter(const DmenuFilter&) = delete;
+    // cancels the run in progress and waits for it to stop
+    ~DmenuFilter();
+
+    // filters on the calling thread, must not be called when busy
+    Result run(const Request& request);
+    // filters on the thread pool
+    void request(Request request);
+    void cancel();
+    // whether the pool may be reading the source, i.e. it must not be modified
+    bool busy() const { return running; }
+private:
+    // shared with the pool job
+    struct Shared {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        Glib::Dispatcher*       dispatcher;           // null when DmenuFilter is gone
+        std::atomic<unsigned>   generation{ 0 };      // incremented to cancel the run
+        bool                    active{ false };      // whether the job is running
+        std::optional<Result>   result;               // null if cancelled
+    };
+    const LineStore&        source;
+    LineStore               keys;    // casefolded source, extended as needed
+    Slot                    on_idle;
+    Glib::Dispatcher        dispatcher;
+    std::shared_ptr<Shared> shared;
+    bool                    running{ false }; // started & not dispatched yet
+    std::optional<Request>  pending;          // requested while running
+
+    bool run_(const Request& request, unsigned generation, Result& result);
+    void start_(Request request);
+    void on_dispatch_();
+};
+
 class DmenuWindow : public PlatformWindow {
     public:
-        DmenuWindow(DmenuConfig&, std::vector<Glib::ustring>&);
+        // called when the menu is hidden, with the selected line or null if nothing was selected
+        using Slot = sigc::slot<void, const Glib::ustring*>;
+
+        DmenuWindow(DmenuConfig&, LineStore path_commands);
         ~DmenuWindow();
-        void emplace_back(const Glib::ustring&);
+        // shows the menu of $PATH commands if `input_fd` is -1, or of the lines read from `input_fd`,
+        // taking its ownership; the menu shown already is closed first
+        void show_menu(int input_fd, Slot on_close);
+        // replaces $PATH commands, closing the menu if it is shown
+        void set_commands(LineStore path_commands);
+        void emplace_back(std::string_view);
 
         int get_height() override;
+    protected:
+        void on_hide() override;
     private:
         void filter_view();
+        void show_matches(const DmenuFilter::Result& result);
+        void on_filtered(const DmenuFilter::Result* result);
+        void on_lines(LineStore& lines, bool eof);
+        bool input_complete() const { return !reader || reader->eof(); }
         void select_first_item();
         void switch_case_sensitivity();
         
@@ -47,13 +180,26 @@ class DmenuWindow : public PlatformWindow {
         Gtk::SearchEntry  searchbox;
         Gtk::ListViewText commands;
         Gtk::VBox         vbox;
-        std::vector<Glib::ustring>& commands_source;
+        LineStore         path_commands;         // $PATH commands
+        LineStore         input_lines;           // lines read from the input
+        LineStore*        commands_source;       // the lines shown, either of the above
+        LineStore         pending_lines;         // lines arrived while the filter was busy
         bool case_sensitivity_changed = false;
+        bool view_final = false;                 // whether new lines can't change the list
         DmenuConfig&       config;
+        std::optional<DmenuFilter>   filter;     // of commands_source
+        std::unique_ptr<StdinReader> reader;     // null in run mode
+        std::optional<Glib::ustring> selection;
+        Slot                         on_close;
 };
 
 /*
  * Function declarations
  * */
-std::vector<Glib::ustring> get_commands_list(const DmenuConfig& config);
+LineStore get_commands_list();
+// identifies the contents of $PATH dirs, changes when a command is added or removed
+std::string get_commands_stamp();
+void run_command(const Glib::ustring& command);
 fs::path get_settings_path();
+// nwgdmenu-server listens on this socket
+fs::path get_socket_path();
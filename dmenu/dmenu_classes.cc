@@ -14,10 +14,19 @@
  * Re-worked for Gtkmm 3.0 by Louis Melahn, L.C. January 31, 2014.
  * */
 
-#include <unistd.h> // isatty
+#include <unistd.h> // isatty, read
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <thread>
 
 #include "charconv-compat.h"
+#include "nwg_pool.h"
 #include "nwg_tools.h"
 #include "dmenu.h"
 
@@ -32,9 +41,13 @@ DmenuConfig::DmenuConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Scre
         case_sensitive = sensitivity == "case_sensitive";
     }
 
-    // We will build dmenu out of commands found in $PATH if nothing has been passed by stdin
-    dmenu_run = parser.cmdOptionExists("-run") || isatty(STDIN_FILENO) == 1;
     show_searchbox = !parser.cmdOptionExists("-n");
+    set_menu_options(parser, STDIN_FILENO);
+}
+
+void DmenuConfig::set_menu_options(const InputParser& parser, int input_fd) {
+    // We will build dmenu out of commands found in $PATH if nothing has been passed by stdin
+    dmenu_run = parser.cmdOptionExists("-run") || input_fd == -1 || isatty(input_fd) == 1;
 
     if (auto rw = parser.getCmdOption("-r"); !rw.empty()){
         int r;
@@ -50,6 +63,356 @@ DmenuConfig::DmenuConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Scre
     }
 }
 
+void LineStore::push_back(std::string_view line) {
+    // lines are copied into chunks of at least CHUNK_SIZE bytes
+    constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+    if (line.empty()) {
+        // nothing to copy, and there may be no chunk to copy into yet
+        lines.emplace_back();
+        return;
+    }
+    if (free_size < line.size()) {
+        free_size = std::max(CHUNK_SIZE, line.size());
+        std::shared_ptr<char[]> chunk{ new char[free_size] };
+        free_space = chunk.get();
+        buffers.push_back(std::move(chunk));
+    }
+    std::memcpy(free_space, line.data(), line.size());
+    lines.emplace_back(free_space, line.size());
+    free_space += line.size();
+    free_size -= line.size();
+}
+
+void LineStore::add_buffer(Buffer buffer) {
+    buffers.push_back(std::move(buffer));
+}
+
+void LineStore::append(LineStore&& other) {
+    if (lines.empty()) {
+        lines.swap(other.lines);
+    } else {
+        lines.insert(lines.end(), other.lines.begin(), other.lines.end());
+        other.lines.clear();
+    }
+    std::move(other.buffers.begin(), other.buffers.end(), std::back_inserter(buffers));
+    other.buffers.clear();
+    other.free_space = nullptr;
+    other.free_size = 0;
+}
+
+StdinReader::StdinReader(int fd, Slot on_lines):
+    shared{ std::make_shared<Shared>() },
+    on_lines{ std::move(on_lines) }
+{
+    shared->dispatcher = &dispatcher;
+    dispatcher.connect(sigc::mem_fun(*this, &StdinReader::on_dispatch_));
+    std::thread{ [shared=shared,fd]() {
+        // the descriptor is closed whichever way the thread ends
+        struct Closer {
+            int fd;
+            ~Closer() { close(fd); }
+        } closer{ fd };
+        LineStore batch;
+        // passes the batch to the main thread, returns false if nobody listens anymore
+        auto publish = [&shared,&batch](bool eof) {
+            std::lock_guard lock{ shared->mutex };
+            if (!shared->dispatcher) {
+                return false;
+            }
+            // the main thread is notified already if there are lines it has not taken yet
+            auto notify = shared->lines.empty();
+            shared->lines.append(std::move(batch));
+            shared->eof = eof;
+            if (notify) {
+                shared->dispatcher->emit();
+            }
+            return true;
+        };
+        // the thread holds its own references to the buffers, as the lines it has published
+        // may be dropped (along with the buffers) by the main thread at any moment
+
+        // regular file: map it and split in place
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            auto size = static_cast<std::size_t>(st.st_size);
+            auto offset = std::min(static_cast<std::size_t>(std::max<off_t>(lseek(fd, 0, SEEK_CUR), 0)), size);
+            if (auto* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0); map != MAP_FAILED) {
+                auto* data = static_cast<const char*>(map);
+                LineStore::Buffer buffer{ data, [size](const char* data) {
+                    munmap(const_cast<char*>(data), size);
+                } };
+                batch.add_buffer(buffer);
+                // publish in batches, so that the first lines are shown right away
+                constexpr std::size_t BATCH_SIZE = 64 * 1024;
+                std::string_view rest{ data + offset, size - offset };
+                while (!rest.empty()) {
+                    auto end = std::min(rest.find('\n'), rest.size());
+                    batch.add_line(rest.substr(0, end));
+                    rest.remove_prefix(std::min(end + 1, rest.size()));
+                    if (batch.size() == BATCH_SIZE && !publish(false)) {
+                        return;
+                    }
+                }
+                publish(true);
+                return;
+            }
+        }
+
+        // pipe or tty: read into chunks, each complete line refers to its chunk
+        constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+        std::size_t capacity = CHUNK_SIZE;
+        std::shared_ptr<char[]> chunk{ new char[capacity] };
+        std::size_t used = 0;         // bytes read to the chunk
+        std::size_t line_start = 0;   // beginning of the incomplete line
+        bool chunk_published = false; // whether the chunk was added to a batch
+        auto add_line = [&](std::size_t end) {
+            if (!chunk_published) {
+                batch.add_buffer(chunk);
+                chunk_published = true;
+            }
+            batch.add_line({ chunk.get() + line_start, end - line_start });
+        };
+        for (;;) {
+            if (used == capacity) {
+                // move the incomplete line to a new chunk, growing it if the line does not fit
+                auto partial = used - line_start;
+                capacity = std::max(CHUNK_SIZE, partial * 2);
+                std::shared_ptr<char[]> next{ new char[capacity] };
+                std::memcpy(next.get(), chunk.get() + line_start, partial);
+                chunk = std::move(next);
+                used = partial;
+                line_start = 0;
+                chunk_published = false;
+            }
+            auto n = read(fd, chunk.get() + used, capacity - used);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                Log::error("Failed to read the input: ", std::strerror(errno));
+            }
+            if (n <= 0) {
+                break;
+            }
+            auto end = used + n;
+            for (auto* newline = chunk.get() + used;
+                 (newline = static_cast<char*>(std::memchr(newline, '\n', chunk.get() + end - newline)));
+                 ++newline)
+            {
+                add_line(newline - chunk.get());
+                line_start = newline - chunk.get() + 1;
+            }
+            used = end;
+            if (!batch.empty() && !publish(false)) {
+                return;
+            }
+        }
+        if (line_start < used) {
+            add_line(used);
+        }
+        publish(true);
+    } }.detach();
+}
+
+StdinReader::~StdinReader() {
+    std::lock_guard lock{ shared->mutex };
+    shared->dispatcher = nullptr;
+}
+
+void StdinReader::on_dispatch_() {
+    LineStore lines;
+    bool eof;
+    {
+        std::lock_guard lock{ shared->mutex };
+        lines.append(std::move(shared->lines));
+        eof = shared->eof;
+    }
+    if (eof_ || (lines.empty() && !eof)) {
+        return;
+    }
+    eof_ = eof;
+    on_lines(lines, eof);
+}
+
+namespace {
+    constexpr std::size_t FILTER_CHUNK_SIZE = 16 * 1024; // lines per pool task
+
+    // appends casefolded `line` to `keys`, `buffer` is a scratch space
+    void push_casefolded(LineStore& keys, std::string_view line, std::string& buffer) {
+        if (std::all_of(line.begin(), line.end(), [](unsigned char c) { return c < 0x80; })) {
+            buffer.assign(line);
+            for (auto && c: buffer) {
+                c = g_ascii_tolower(c);
+            }
+            keys.push_back(buffer);
+        } else {
+            auto* folded = g_utf8_casefold(line.data(), line.size());
+            keys.push_back(folded);
+            g_free(folded);
+        }
+    }
+}
+
+DmenuFilter::DmenuFilter(const LineStore& source, Slot on_idle):
+    source{ source },
+    on_idle{ std::move(on_idle) },
+    shared{ std::make_shared<Shared>() }
+{
+    shared->dispatcher = &dispatcher;
+    dispatcher.connect(sigc::mem_fun(*this, &DmenuFilter::on_dispatch_));
+}
+
+DmenuFilter::~DmenuFilter() {
+    std::unique_lock lock{ shared->mutex };
+    shared->dispatcher = nullptr;
+    ++shared->generation;
+    // the job uses `source` & `keys`
+    shared->cv.wait(lock, [this]() { return !shared->active; });
+}
+
+DmenuFilter::Result DmenuFilter::run(const Request& request) {
+    Result result;
+    run_(request, shared->generation.load(), result);
+    return result;
+}
+
+void DmenuFilter::request(Request request) {
+    if (running) {
+        cancel();
+        pending = std::move(request);
+    } else {
+        start_(std::move(request));
+    }
+}
+
+void DmenuFilter::cancel() {
+    ++shared->generation;
+    pending.reset();
+}
+
+void DmenuFilter::start_(Request request) {
+    running = true;
+    std::lock_guard lock{ shared->mutex };
+    shared->active = true;
+    ThreadPool::global().submit([this,shared=shared,request=std::move(request),generation=shared->generation.load()]() {
+        Result result;
+        auto done = run_(request, generation, result);
+        std::lock_guard lock{ shared->mutex };
+        shared->result.reset();
+        if (done && shared->generation == generation) {
+            shared->result = std::move(result);
+        }
+        shared->active = false;
+        shared->cv.notify_all();
+        if (shared->dispatcher) {
+            shared->dispatcher->emit();
+        }
+    });
+}
+
+void DmenuFilter::on_dispatch_() {
+    std::optional<Result> result;
+    {
+        std::lock_guard lock{ shared->mutex };
+        result.swap(shared->result);
+    }
+    running = false;
+    if (pending) {
+        auto request = std::move(*pending);
+        pending.reset();
+        start_(std::move(request));
+        return;
+    }
+    on_idle(result ? &*result : nullptr);
+}
+
+bool DmenuFilter::run_(const Request& request, unsigned generation, Result& result) {
+    auto size = source.size();
+    auto chunks = (size + FILTER_CHUNK_SIZE - 1) / FILTER_CHUNK_SIZE;
+    auto for_each_chunk = [chunks](auto && f) {
+        if (chunks > 1) {
+            ThreadPool::global().parallel_for(chunks, f);
+        } else if (chunks == 1) {
+            f(0);
+        }
+    };
+    if (!request.case_sensitive && keys.size() < size) {
+        // casefold the lines once rather than on every keystroke
+        auto first = keys.size();
+        std::vector<LineStore> parts((size - first + FILTER_CHUNK_SIZE - 1) / FILTER_CHUNK_SIZE);
+        auto fold = [&](std::size_t part) {
+            std::string buffer;
+            auto end = std::min(size, first + (part + 1) * FILTER_CHUNK_SIZE);
+            for (auto i = first + part * FILTER_CHUNK_SIZE; i < end; ++i) {
+                push_casefolded(parts[part], source[i], buffer);
+            }
+        };
+        if (parts.size() > 1) {
+            ThreadPool::global().parallel_for(parts.size(), fold);
+        } else {
+            fold(0);
+        }
+        for (auto && part: parts) {
+            keys.append(std::move(part));
+        }
+    }
+    // commands are matched byte-wise, which is fine for utf-8
+    auto && haystack = request.case_sensitive ? source : keys;
+    std::string_view phrase = request.phrase;
+    auto rows = request.rows;
+    struct Matches {
+        std::vector<std::size_t> exact;
+        std::vector<std::size_t> almost;
+    };
+    std::vector<Matches> matches(chunks);
+    std::atomic<bool> cancelled{ false };
+    for_each_chunk([&](std::size_t chunk) {
+        auto && [exact, almost] = matches[chunk];
+        auto end = std::min(size, (chunk + 1) * FILTER_CHUNK_SIZE);
+        for (auto i = chunk * FILTER_CHUNK_SIZE; i < end; ++i) {
+            if (i % 1024 == 0 && shared->generation.load(std::memory_order_relaxed) != generation) {
+                cancelled = true;
+                return;
+            }
+            if (auto pos = haystack[i].find(phrase); pos == 0) {
+                if (exact.size() < rows) {
+                    exact.push_back(i);
+                }
+            } else if (pos != phrase.npos && almost.size() < rows) {
+                almost.push_back(i);
+            }
+            if (exact.size() == rows) {
+                // the following lines can't get to the results of this chunk
+                break;
+            }
+        }
+    });
+    if (cancelled) {
+        return false;
+    }
+    // merge the chunks: prefix matches first, then the rest, both in source order
+    result.lines.clear();
+    for (auto && m: matches) {
+        for (auto i: m.exact) {
+            if (result.lines.size() == rows) {
+                break;
+            }
+            result.lines.push_back(i);
+        }
+    }
+    result.exact = result.lines.size();
+    for (auto && m: matches) {
+        for (auto i: m.almost) {
+            if (result.lines.size() == rows) {
+                break;
+            }
+            result.lines.push_back(i);
+        }
+    }
+    result.source_size = size;
+    return true;
+}
+
 inline auto set_searchbox_placeholder = [](auto && searchbox, auto case_sensitive) {
     constexpr std::array placeholders { "TYPE TO SEARCH", "Type to Search" };
     searchbox.set_placeholder_text(placeholders[case_sensitive]);
@@ -66,10 +429,11 @@ inline auto build_commands_list = [](auto && dmenu, auto && commands, auto max)
     }
 };
 
-DmenuWindow::DmenuWindow(DmenuConfig& config, std::vector<Glib::ustring>& src):
+DmenuWindow::DmenuWindow(DmenuConfig& config, LineStore path_commands):
     PlatformWindow{ config },
     commands{ 1, false, Gtk::SELECTION_SINGLE },
-    commands_source{ src },
+    path_commands{ std::move(path_commands) },
+    commands_source{ &this->path_commands },
     config{ config }
 {
     // different shells emit different events
@@ -99,13 +463,8 @@ DmenuWindow::DmenuWindow(DmenuConfig& config, std::vector<Glib::ustring>& src):
         auto iter = model->get_iter(path);
         Glib::ustring item;
         iter->get_value(0, item);
-        try {
-            Glib::spawn_command_line_async(item);
-        } catch (const Glib::SpawnError& error) {
-            Log::error("Failed to run command: ", error.what());
-        } catch (const Glib::ShellError& error) {
-            Log::error("Failed to run command: ", error.what());
-        }
+        // passed to on_close once the window is hidden
+        this->selection = std::move(item);
         this->close();
     });
     searchbox.set_name("searchbox");
@@ -118,7 +477,7 @@ DmenuWindow::DmenuWindow(DmenuConfig& config, std::vector<Glib::ustring>& src):
     
     add(vbox);
     
-    build_commands_list(*this, commands_source, config.rows);
+    filter.emplace(*commands_source, sigc::mem_fun(*this, &DmenuWindow::on_filtered));
 }
 
 DmenuWindow::~DmenuWindow() {
@@ -130,51 +489,160 @@ DmenuWindow::~DmenuWindow() {
     }
 }
 
-void DmenuWindow::emplace_back(const Glib::ustring& command) {
-    this->commands.append(command);
+void DmenuWindow::show_menu(int input_fd, Slot on_close) {
+    if (get_visible()) {
+        hide();
+    }
+    // forget the previous menu; the filter may still be reading its lines
+    auto* source = input_fd == -1 ? &path_commands : &input_lines;
+    pending_lines = LineStore{};
+    if (source == commands_source && source == &path_commands) {
+        // keep the casefolded commands
+        filter->cancel();
+    } else {
+        filter.reset();
+        input_lines = LineStore{};
+        commands_source = source;
+        filter.emplace(*commands_source, sigc::mem_fun(*this, &DmenuWindow::on_filtered));
+    }
+    this->on_close = std::move(on_close);
+    selection.reset();
+    if (!searchbox.get_text().empty()) {
+        searchbox.set_text("");
+    }
+    auto model_refptr = commands.get_model();
+    dynamic_cast<Gtk::ListStore&>(*model_refptr.get()).clear();
+    build_commands_list(*this, *commands_source, config.rows);
+    if (input_fd != -1) {
+        reader = std::make_unique<StdinReader>(input_fd, sigc::mem_fun(*this, &DmenuWindow::on_lines));
+    }
+    view_final = input_complete() || commands_source->size() >= std::size_t(config.rows);
+
+    switch (2 * (config.valign == VAlign::NotSpecified) + (config.halign == HAlign::NotSpecified )) {
+        case 0:
+            show(hint::Sides{ { config.halign == HAlign::Right, 50 }, { config.valign == VAlign::Bottom, 50 } }); break;
+        case 1:
+            show(hint::Side<hint::Vertical>{ config.valign == VAlign::Bottom, 50 }); break;
+        case 2:
+            show(hint::Side<hint::Horizontal>{ config.halign == HAlign::Right, 50 }); break;
+        case 3:
+            show(hint::Center); break;
+    }
+    if (!commands_source->empty()) {
+        select_first_item();
+    }
+}
+
+void DmenuWindow::set_commands(LineStore path_commands) {
+    if (get_visible()) {
+        hide();
+    }
+    if (commands_source == &this->path_commands) {
+        // the filter refers to the old commands
+        filter.reset();
+        this->path_commands = std::move(path_commands);
+        filter.emplace(*commands_source, sigc::mem_fun(*this, &DmenuWindow::on_filtered));
+    } else {
+        this->path_commands = std::move(path_commands);
+    }
+}
+
+void DmenuWindow::on_hide() {
+    // the rest of the input is not needed
+    reader.reset();
+    auto slot = std::move(on_close);
+    on_close = Slot{};
+    auto selected = std::move(selection);
+    selection.reset();
+    if (!slot.empty()) {
+        slot(selected ? &*selected : nullptr);
+    }
+    return PlatformWindow::on_hide();
+}
+
+void DmenuWindow::emplace_back(std::string_view command) {
+    this->commands.append(Glib::ustring{ command.begin(), command.end() });
 }
 
 void DmenuWindow::filter_view() {
-    auto model_refptr = commands.get_model();
-    auto& model = dynamic_cast<Gtk::ListStore&>(*model_refptr.get());
-    model.clear();
     auto search_phrase = searchbox.get_text();
-    if (search_phrase.length() > 0) {
-        // append at most `max` entries satisfying `matches` predicate, return count
-        auto fill_matches = [this](auto && source, auto && matches, auto max) {
-            decltype(max) count = 0;
-            auto begin = source.begin(); auto end = source.end();
-            while (begin < end && count < max) {
-                auto && command = *begin++;
-                if (matches(command)) {
-                    this->emplace_back(command);
-                    count++;
-                }
-            }
-            return count;
-        };
-        // append entries matching `exact`, then entries matching `almost` (at most `max` entries)
-        auto fill_all = [this,fill_matches,rows=config.rows](auto && exact, auto && almost) {
-            auto count = fill_matches(this->commands_source, exact, rows);
-            if (count < rows) {
-                fill_matches(this->commands_source, almost, rows - count);
-            }
-        };
-        if (config.case_sensitive) {
-            fill_all([&a=search_phrase](auto && b){ return b.find(a) == 0; },
-                     [&a=search_phrase](auto && b){ auto r = b.find(a); return r > 0 && r != a.npos; });
-        } else {
-            auto sf = search_phrase.casefold();
-            fill_all([&a=sf](auto && b){ return b.casefold().find(a) == 0; },
-                     [&a=sf](auto && b){ auto r = b.casefold().find(a); return r > 0 && r != a.npos; });
-        }
-    } else {
+    if (search_phrase.empty()) {
         // searchentry is clear, show all options
-        build_commands_list(*this, commands_source, config.rows);
+        filter->cancel();
+        auto model_refptr = commands.get_model();
+        dynamic_cast<Gtk::ListStore&>(*model_refptr.get()).clear();
+        build_commands_list(*this, *commands_source, config.rows);
+        view_final = input_complete() || commands_source->size() >= std::size_t(config.rows);
+        select_first_item();
+        return;
+    }
+    DmenuFilter::Request request {
+        config.case_sensitive ? search_phrase.raw() : search_phrase.casefold().raw(),
+        config.case_sensitive,
+        std::size_t(config.rows)
+    };
+    if (filter->busy() || commands_source->size() >= DmenuFilter::PARALLEL_THRESHOLD) {
+        // the list is updated in on_filtered
+        view_final = false;
+        filter->request(std::move(request));
+    } else {
+        show_matches(filter->run(request));
     }
+}
+
+void DmenuWindow::show_matches(const DmenuFilter::Result& result) {
+    auto model_refptr = commands.get_model();
+    dynamic_cast<Gtk::ListStore&>(*model_refptr.get()).clear();
+    for (auto i: result.lines) {
+        emplace_back((*commands_source)[i]);
+    }
+    view_final = result.exact == std::size_t(config.rows)
+        || (input_complete() && result.source_size == commands_source->size());
     select_first_item();
 }
 
+void DmenuWindow::on_filtered(const DmenuFilter::Result* result) {
+    // the source can be modified now
+    auto grown = !pending_lines.empty();
+    commands_source->append(std::move(pending_lines));
+    if (result) {
+        show_matches(*result);
+    }
+    if (grown && !view_final && !searchbox.get_text().empty()) {
+        filter_view();
+    }
+}
+
+void DmenuWindow::on_lines(LineStore& lines, bool eof) {
+    if (eof) {
+        Log::info(commands_source->size() + pending_lines.size() + lines.size(), " lines read from stdin");
+    }
+    if (filter->busy()) {
+        // the pool is reading the source, wait for it
+        pending_lines.append(std::move(lines));
+        return;
+    }
+    auto first = commands_source->size();
+    commands_source->append(std::move(lines));
+    if (view_final) {
+        return;
+    }
+    if (searchbox.get_text().empty()) {
+        // just append the new commands, preserving the cursor
+        auto model_refptr = commands.get_model();
+        auto rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(model_refptr->gobj()), nullptr);
+        for (auto i = first; i < commands_source->size() && rows < config.rows; ++i, ++rows) {
+            emplace_back((*commands_source)[i]);
+        }
+        if (first == 0) {
+            select_first_item();
+        }
+        view_final = eof || rows == config.rows;
+    } else {
+        filter_view();
+    }
+}
+
 void DmenuWindow::select_first_item() {
     Gtk::ListStore::Path path{1};
     commands.set_cursor(path);
@@ -231,6 +699,10 @@ int DmenuWindow::get_height() {
     auto model = commands.get_model();
     // Gtk::TreeModel::iter_n_root_children is protected, so ...
     auto rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(model->gobj()), nullptr);
+    // the window is positioned before the input arrives, assume it fills the list
+    if (reader && !reader->eof()) {
+        rows = config.rows;
+    }
     auto base_height = CommonWindow::get_height();
     int off_x = -1, off_y = -1, cell_width = -1, cell_height = -1;
     Gdk::Rectangle rect;
@@ -0,0 +1,207 @@
+/*
+ * GTK-based dmenu
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#include "nwg_socket.h"
+#include "nwg_tools.h"
+#include "nwg_classes.h"
+#include "dmenu.h"
+
+#define STR_EXPAND(x) #x
+#define STR(x) STR_EXPAND(x)
+
+const char* const HELP_MESSAGE =
+"GTK dynamic menu: nwgdmenu-server " VERSION_STR " (c) Piotr Miller & Contributors 2021\n\n\
+Keeps nwgdmenu window, style & $PATH commands loaded and shows the menu:\n\
+- of $PATH commands on SIGUSR1, running the selected one\n\
+- on `nwgdmenu -client [ARGS]` request, see `nwgdmenu -h`\n\n\
+Options:\n\
+-h               show this help message and exit\n\
+-n               no search box\n\
+-ha <l>|<r>      horizontal alignment left/right (default: center)\n\
+-va <t>|<b>      vertical alignment top/bottom (default: middle)\n\
+-r <rows>        number of rows (default: " STR(ROWS_DEFAULT) "), the client may override it\n\
+-c <name>        css file name (default: style.css)\n\
+-o <opacity>     background opacity (0.0 - 1.0, default 0.3)\n\
+-b <background>  background colour in RRGGBB or RRGGBBAA format (RRGGBBAA alpha overrides <opacity>)\n\
+-g <theme>       GTK theme name\n\
+-wm <wmname>     window manager name (if can not be detected)\n\n\
+[requires layer-shell]:\n\
+-layer-shell-layer          {BACKGROUND,BOTTOM,TOP,OVERLAY},        default: OVERLAY\n\
+-layer-shell-exclusive-zone {auto, valid integer (usually -1 or 0)}, default: auto\n";
+
+struct DmenuServer;
+
+/* Instance on_* handlers call Application::quit, which does not call destructors,
+ * so the socket & settings would not be cleaned up */
+struct DmenuInstance: public Instance {
+    DmenuServer& server;
+
+    DmenuInstance(Gtk::Application& app, DmenuServer& server):
+        Instance{ app, "nwgdmenu-server" }, server{ server }
+    {
+        // intentionally left blank
+    }
+    void on_sigusr1() override; // show $PATH commands
+    void on_sigint() override { app.release(); }
+    void on_sigterm() override { app.release(); }
+};
+
+/* Shows the menus requested by the clients & SIGUSR1 */
+struct DmenuServer {
+    DmenuConfig&  config;
+    DmenuWindow&  window;
+    int           rows;           // set by the server options
+    std::string   commands_stamp; // of the commands shown in run mode
+    // the instance terminates the running server, which removes its socket, so it goes first
+    DmenuInstance instance;
+    SocketServer  socket;
+
+    DmenuServer(Gtk::Application& app, DmenuConfig& config, DmenuWindow& window, std::string commands_stamp):
+        config{ config },
+        window{ window },
+        rows{ config.rows },
+        commands_stamp{ std::move(commands_stamp) },
+        instance{ app, *this },
+        socket{ get_socket_path(), [this](auto && request) { on_request(request); } }
+    {
+        // intentionally left blank
+    }
+
+    // reloads $PATH commands if they have changed
+    void update_commands() {
+        if (auto stamp = get_commands_stamp(); stamp != commands_stamp) {
+            commands_stamp = std::move(stamp);
+            window.set_commands(get_commands_list());
+        }
+    }
+
+    // shows $PATH commands, the selected one is run by the server
+    void show_run_menu() {
+        config.rows = rows;
+        config.dmenu_run = true;
+        update_commands();
+        window.show_menu(-1, [](const Glib::ustring* selection) {
+            if (selection) {
+                run_command(*selection);
+            }
+        });
+    }
+
+    void on_request(SocketServer::Request& request) {
+        // the request is the client arguments, each terminated by '\0'
+        std::vector<char*> args;
+        for (std::size_t begin = 0, end; begin < request.message.size(); begin = end + 1) {
+            end = request.message.find('\0', begin);
+            if (end == request.message.npos) {
+                Log::error("Malformed request");
+                return;
+            }
+            args.push_back(request.message.data() + begin);
+        }
+        if (args.empty()) {
+            Log::error("Malformed request");
+            return;
+        }
+        InputParser input{ static_cast<int>(args.size()), args.data() };
+        auto input_fd = request.fds.empty() ? -1 : std::exchange(request.fds.front(), -1);
+        config.rows = rows;
+        config.set_menu_options(input, input_fd);
+        if (config.dmenu_run && input_fd != -1) {
+            close(input_fd);
+            input_fd = -1;
+        }
+        if (config.dmenu_run) {
+            update_commands();
+        }
+        // slots must be copyable, so is the connection
+        auto connection = std::make_shared<SocketConnection>(std::move(request.connection));
+        window.show_menu(input_fd, [connection,run=config.dmenu_run](const Glib::ustring* selection) {
+            if (!selection) {
+                // closing the connection tells the client nothing was selected
+                connection->close();
+                return;
+            }
+            if (run) {
+                run_command(*selection);
+            }
+            try {
+                connection->send(concat(selection->raw(), '\n'));
+            } catch (const std::exception& e) {
+                Log::error("Failed to reply to the client: ", e.what());
+            }
+            connection->close();
+        });
+    }
+};
+
+void DmenuInstance::on_sigusr1() {
+    server.show_run_menu();
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        InputParser input(argc, argv);
+        if (input.cmdOptionExists("-h")){
+            std::cout << HELP_MESSAGE;
+            std::exit(0);
+        }
+
+        auto background_color = input.get_background_color(0.3);
+
+        auto config_dir = get_config_dir("nwgdmenu");
+        if (!fs::is_directory(config_dir)) {
+            Log::info("Config dir not found, creating...");
+            fs::create_directories(config_dir);
+        }
+
+        auto app = Gtk::Application::create();
+
+        auto provider = Gtk::CssProvider::create();
+        auto display = Gdk::Display::get_default();
+        auto screen = display->get_default_screen();
+        auto settings = Gtk::Settings::get_for_screen(screen);
+        if (!provider || !display || !settings || !screen) {
+            Log::error("Failed to initialize GTK");
+            return EXIT_FAILURE;
+        }
+        DmenuConfig config {
+            input,
+            screen
+        };
+
+        settings->property_gtk_theme_name() = config.theme;
+
+        Gtk::StyleContext::add_provider_for_screen(screen, provider, GTK_STYLE_PROVIDER_PRIORITY_USER);
+        {
+            auto css_file = setup_css_file("nwgdmenu", config_dir, config.css_filename);
+            Log::info("Using css file \'", css_file, "\'");
+            provider->load_from_path(css_file);
+        }
+
+        auto commands_stamp = get_commands_stamp();
+        DmenuWindow window{ config, get_commands_list() };
+        window.set_background_color(background_color);
+        window.show_all_children();
+
+        DmenuServer server{ *app.get(), config, window, std::move(commands_stamp) };
+        app->hold();
+        return app->run();
+    } catch (const Glib::FileError& error) {
+        Log::error(error.what());
+    } catch (const std::runtime_error& error) {
+        Log::error(error.what());
+    }
+    return EXIT_FAILURE;
+}
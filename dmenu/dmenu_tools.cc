@@ -6,9 +6,16 @@
  * License: GPL3
  * */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <utility>
 
 #include "filesystem-compat.h"
 #include "nwg_tools.h"
@@ -24,21 +31,146 @@ fs::path get_settings_path() {
 }
 
 /*
- * Returns all commands paths
+ * Returns nwgdmenu-server socket path
+ * */
+fs::path get_socket_path() {
+    return get_runtime_dir() / "nwgdmenu.sock";
+}
+
+/*
+ * Runs the command selected in the menu
+ * */
+void run_command(const Glib::ustring& command) {
+    try {
+        Glib::spawn_command_line_async(command);
+    } catch (const Glib::SpawnError& error) {
+        Log::error("Failed to run command: ", error.what());
+    } catch (const Glib::ShellError& error) {
+        Log::error("Failed to run command: ", error.what());
+    }
+}
+
+/*
+ * Cache of the commands found in $PATH, a text file:
+ *   MAGIC
+ *   $PATH
+ *   mtime of each $PATH dir in nanoseconds (0 if it does not exist), space separated
+ *   command per line, sorted
+ * The cache is valid as long as $PATH and the mtimes are the same.
  * */
-static std::vector<Glib::ustring> list_commands() {
-    std::vector<Glib::ustring> commands;
-    if (auto command_dirs_ = getenv("PATH")) {
-        std::string command_dirs{ command_dirs_ };
-        auto paths = split_string(command_dirs, ":");
+namespace {
+    constexpr std::string_view PATH_CACHE_MAGIC = "nwgdmenu-path-cache 1";
+
+    std::int64_t dir_mtime(std::string_view dir) {
+        struct stat st;
+        if (stat(std::string{ dir }.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            return 0;
+        }
+        return std::int64_t{ st.st_mtim.tv_sec } * 1'000'000'000 + st.st_mtim.tv_nsec;
+    }
+
+    std::string serialize_mtimes(const std::vector<std::int64_t>& mtimes) {
+        std::string result;
+        for (auto mtime: mtimes) {
+            if (!result.empty()) {
+                result += ' ';
+            }
+            result += std::to_string(mtime);
+        }
+        return result;
+    }
+
+    // loads the commands from the cache unless it's stale; the commands refer to the mapped file
+    bool load_path_cache(const fs::path& file, std::string_view path, std::string_view mtimes, LineStore& commands) {
+        auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        auto size = static_cast<std::size_t>(st.st_size);
+        auto* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        auto* data = static_cast<const char*>(map);
+        LineStore::Buffer buffer{ data, [size](const char* data) {
+            munmap(const_cast<char*>(data), size);
+        } };
+        std::string_view rest{ data, size };
+        auto next_line = [&rest]() {
+            auto end = std::min(rest.find('\n'), rest.size());
+            auto line = rest.substr(0, end);
+            rest.remove_prefix(std::min(end + 1, rest.size()));
+            return line;
+        };
+        if (next_line() != PATH_CACHE_MAGIC || next_line() != path || next_line() != mtimes) {
+            return false;
+        }
+        commands.add_buffer(std::move(buffer));
+        while (!rest.empty()) {
+            commands.add_line(next_line());
+        }
+        return true;
+    }
+
+    // $PATH and its dirs mtimes
+    std::pair<std::string, std::string> path_state() {
+        std::string path;
+        if (auto path_ = getenv("PATH")) {
+            path = path_;
+        }
+        std::vector<std::int64_t> mtimes;
+        for (auto && dir: split_string(path, ":")) {
+            mtimes.push_back(dir_mtime(dir));
+        }
+        return { std::move(path), serialize_mtimes(mtimes) };
+    }
+
+    void save_path_cache(const fs::path& file, std::string_view path, std::string_view mtimes, LineStore& commands) {
+        // per process, as two nwgdmenu may save at the same time
+        auto tmp_file = file;
+        tmp_file += concat(".", std::to_string(getpid()));
+        {
+            std::ofstream out{ tmp_file, std::ios::trunc };
+            out << PATH_CACHE_MAGIC << '\n' << path << '\n' << mtimes << '\n';
+            for (auto command: commands) {
+                out << command << '\n';
+            }
+            if (!out) {
+                Log::error("Failed to write commands cache '", tmp_file, "'");
+                out.close();
+                std::error_code ec;
+                fs::remove(tmp_file, ec);
+                return;
+            }
+        }
         std::error_code ec;
-        for (auto && dir: paths) {
-            if (fs::is_directory(dir, ec) && !ec) {
-                for (auto && entry: fs::directory_iterator(dir)) {
-                    auto cmd = take_last_by(entry.path().native(), "/");
-                    if (cmd.size() > 1 && cmd[0] != '.') {
-                        commands.emplace_back(cmd.data(), cmd.size());
-                    }
+        fs::rename(tmp_file, file, ec);
+        if (ec) {
+            Log::error("Failed to save commands cache '", file, "': ", ec.message());
+            fs::remove(tmp_file, ec);
+        }
+    }
+}
+
+/*
+ * Returns all commands found in `dirs`
+ * */
+static LineStore list_commands(const std::vector<std::string_view>& dirs) {
+    LineStore commands;
+    std::error_code ec;
+    for (auto && dir: dirs) {
+        if (fs::is_directory(dir, ec) && !ec) {
+            for (auto && entry: fs::directory_iterator(dir)) {
+                auto cmd = take_last_by(entry.path().native(), "/");
+                // the cache is line-based
+                if (cmd.size() > 1 && cmd[0] != '.' && cmd.find('\n') == cmd.npos) {
+                    commands.push_back(cmd);
                 }
             }
         }
@@ -47,25 +179,32 @@ static std::vector<Glib::ustring> list_commands() {
 }
 
 /*
- * Returns list of commands loaded according to config
+ * Returns the commands found in $PATH
  * */
-std::vector<Glib::ustring> get_commands_list(const DmenuConfig& config) {
-    std::vector<Glib::ustring> all_commands;
-    if (config.dmenu_run) {
-        /* get a list of paths to all commands from all application dirs */
-        all_commands = list_commands();
-        Log::info(all_commands.size(), " commands found");
-
-        /* Sort case insensitive */
-        std::sort(all_commands.begin(), all_commands.end(), [](auto& a, auto& b) {
-            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](auto a, auto b) {
-                return std::tolower(a) < std::tolower(b);
-            });
-        });
-    } else {
-        for (std::string line; std::getline(std::cin, line);) {
-            all_commands.emplace_back(std::move(line));
-        }
+LineStore get_commands_list() {
+    LineStore all_commands;
+    auto [path, mtimes] = path_state();
+    auto cache_file = get_cache_home() / "nwg-dmenu-path";
+    if (load_path_cache(cache_file, path, mtimes, all_commands)) {
+        Log::info(all_commands.size(), " commands loaded from cache");
+        return all_commands;
     }
+
+    /* get a list of paths to all commands from all application dirs */
+    all_commands = list_commands(split_string(path, ":"));
+    Log::info(all_commands.size(), " commands found");
+
+    /* Sort case insensitive */
+    std::sort(all_commands.begin(), all_commands.end(), [](auto a, auto b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](unsigned char a, unsigned char b) {
+            return std::tolower(a) < std::tolower(b);
+        });
+    });
+    save_path_cache(cache_file, path, mtimes, all_commands);
     return all_commands;
 }
+
+std::string get_commands_stamp() {
+    auto [path, mtimes] = path_state();
+    return concat(path, '\n', mtimes);
+}
@@ -0,0 +1,110 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <functional>
+
+#include "desktop_ids.h"
+
+namespace {
+    // fits the usual number of installed applications without growing
+    constexpr std::size_t MIN_BUCKETS = 1024;
+
+    inline std::size_t hash_of(std::string_view id) {
+        return std::hash<std::string_view>{}(id);
+    }
+}
+
+DesktopIds::DesktopIds():
+    buckets(MIN_BUCKETS, NONE)
+{
+    // intentionally left blank
+}
+
+std::size_t DesktopIds::probe_(std::string_view id, std::size_t hash) const {
+    auto mask = mask_();
+    auto i = hash & mask;
+    for (; buckets[i] != NONE; i = (i + 1) & mask) {
+        auto && entry = ids[buckets[i]];
+        if (entry.hash == hash && entry.id == id) {
+            break;
+        }
+    }
+    return i;
+}
+
+auto DesktopIds::find(std::string_view id) const -> Slot {
+    return buckets[probe_(id, hash_of(id))];
+}
+
+auto DesktopIds::acquire(std::string_view id) -> Slot {
+    auto hash = hash_of(id);
+    auto i = probe_(id, hash);
+    if (auto slot = buckets[i]; slot != NONE) {
+        ++ids[slot].refs;
+        return slot;
+    }
+    if ((count + 1) * 2 > buckets.size()) {
+        grow_();
+        i = probe_(id, hash);
+    }
+    Slot slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        slot = ids.size();
+        ids.emplace_back();
+    }
+    auto && entry = ids[slot];
+    entry.id.assign(id);
+    entry.hash = hash;
+    entry.refs = 1;
+    buckets[i] = slot;
+    ++count;
+    return slot;
+}
+
+void DesktopIds::release(Slot slot) {
+    auto && entry = ids[slot];
+    if (--entry.refs > 0) {
+        return;
+    }
+    auto mask = mask_();
+    auto hole = entry.hash & mask;
+    while (buckets[hole] != slot) {
+        hole = (hole + 1) & mask;
+    }
+    // backward shift: the following slots of the cluster move into the hole unless it precedes their home bucket
+    for (auto i = (hole + 1) & mask; buckets[i] != NONE; i = (i + 1) & mask) {
+        auto home = ids[buckets[i]].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            buckets[hole] = buckets[i];
+            hole = i;
+        }
+    }
+    buckets[hole] = NONE;
+    entry.id.clear();
+    free_slots.push_back(slot);
+    --count;
+}
+
+void DesktopIds::grow_() {
+    std::vector<Slot> next(buckets.size() * 2, NONE);
+    auto mask = next.size() - 1;
+    for (auto slot: buckets) {
+        if (slot == NONE) {
+            continue;
+        }
+        auto i = ids[slot].hash & mask;
+        while (next[i] != NONE) {
+            i = (i + 1) & mask;
+        }
+        next[i] = slot;
+    }
+    buckets.swap(next);
+}
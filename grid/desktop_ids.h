@@ -0,0 +1,68 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* DesktopIds interns desktop ids, giving each one a slot: a small integer which stays the same while
+ * the id is interned, so the data kept per id (file metadata, preset stats, boxes) lives in plain vectors
+ * indexed by slot instead of maps keyed by strings.
+ * Ids are reference counted: the slot is freed & reused once the last reference is released.
+ * Lookup is an open-addressing hash table of slots with linear probing, kept at most half full;
+ * erasing shifts the rest of the probe sequence back, so there are no tombstones.
+ * The interned strings never move, views of them are valid until the id is freed. */
+class DesktopIds {
+public:
+    using Slot = std::uint32_t;
+    static constexpr Slot NONE = std::numeric_limits<Slot>::max();
+
+    DesktopIds();
+    DesktopIds(const DesktopIds&) = delete;
+
+    // the slot of `id` or NONE if it is not interned
+    Slot find(std::string_view id) const;
+    // interns `id` unless it is already interned & takes a reference to it
+    Slot acquire(std::string_view id);
+    // drops the reference taken by `acquire`, the last one frees the slot
+    void release(Slot slot);
+    std::string_view operator[](Slot slot) const {
+        return ids[slot].id;
+    }
+    // all slots are below it, size the per-slot vectors to it
+    std::size_t capacity() const {
+        return ids.size();
+    }
+    std::size_t size() const {
+        return count;
+    }
+private:
+    struct Id {
+        std::string id;
+        std::size_t hash{ 0 };
+        std::size_t refs{ 0 }; // the slot is free if 0
+    };
+
+    std::deque<Id>    ids;          // by slot, deque keeps the strings in place when growing
+    std::vector<Slot> free_slots;   // reused before new ones are made
+    std::vector<Slot> buckets;      // power of two sized, NONE if empty
+    std::size_t       count{ 0 };   // interned ids
+
+    std::size_t mask_() const {
+        return buckets.size() - 1;
+    }
+    // the bucket holding `id` or the empty bucket ending its probe sequence
+    std::size_t probe_(std::string_view id, std::size_t hash) const;
+    void grow_();
+};
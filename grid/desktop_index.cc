@@ -0,0 +1,300 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <array>
+#include <fstream>
+#include <vector>
+
+#include "nwg_exceptions.h"
+#include "nwg_tools.h"
+#include "desktop_index.h"
+
+/*
+ * Index file layout (native endianness, the index is never shared between machines):
+ *   Header
+ *   Record[Header::count]
+ *   char pool[Header::pool_size]  -- all strings, referenced by Str{ offset, size }
+ * Header & Record sizes are multiples of 8, so records are properly aligned in the mapping.
+ */
+namespace {
+    constexpr std::array<char, 8> MAGIC { 'N', 'W', 'G', 'I', 'D', 'X', '\0', '\0' };
+    // bump every time Header, Record or FIELDS change
+    constexpr std::uint32_t VERSION = 3;
+
+    struct Str {
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+    struct Header {
+        std::array<char, 8> magic;
+        std::uint32_t       version;
+        std::uint32_t       count;
+        std::uint64_t       pool_size;
+        Str                 key;
+    };
+
+    // DesktopEntry string fields in the order they are stored in Record
+    constexpr std::array FIELDS {
+        &DesktopEntry::name,
+        &DesktopEntry::exec,
+        &DesktopEntry::icon,
+        &DesktopEntry::comment,
+        &DesktopEntry::mime_type,
+        &DesktopEntry::keywords,
+        &DesktopEntry::try_exec,
+        &DesktopEntry::categories,
+        &DesktopEntry::only_show_in,
+        &DesktopEntry::not_show_in,
+        &DesktopEntry::startup_wm_class,
+        &DesktopEntry::actions
+    };
+}
+
+struct DesktopIndex::Record {
+    Stamp                          stamp;
+    Str                            path;
+    std::uint8_t                   state;
+    std::uint8_t                   terminal;
+    std::array<std::uint8_t, 6>    padding_;
+    std::array<Str, FIELDS.size()> fields;
+};
+
+static_assert(sizeof(Header) % 8 == 0, "Header size must keep records aligned");
+static_assert(sizeof(DesktopIndex::Record) % 8 == 0, "Record size must keep records aligned");
+
+DesktopIndex::DesktopIndex(fs::path file, const DesktopEntryConfig& config):
+    file{ std::move(file) },
+    config{ config },
+    key{ config.lang }
+{
+    try {
+        load_();
+    } catch (const std::exception& e) {
+        // the index is merely a cache, it's fine to rebuild it
+        Log::warn("Failed to load desktop index '", this->file, "': ", e.what());
+        records.clear();
+        records_count = 0;
+        saved_count = 0;
+    }
+}
+
+DesktopIndex::~DesktopIndex() {
+    if (map) {
+        munmap(map, map_size);
+    }
+}
+
+void DesktopIndex::load_() {
+    auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        int err = errno;
+        if (err == ENOENT) {
+            return;
+        }
+        throw ErrnoException{ "failed to open: ", err };
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw ErrnoException{ "failed to stat: ", err };
+    }
+    map_size = st.st_size;
+    if (map_size < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error{ "file is truncated" };
+    }
+    map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        int err = errno;
+        map = nullptr;
+        throw ErrnoException{ "failed to mmap: ", err };
+    }
+
+    auto* base = static_cast<const char*>(map);
+    auto* header = reinterpret_cast<const Header*>(base);
+    if (header->magic != MAGIC || header->version != VERSION) {
+        Log::info("Desktop index has unknown format, it will be rebuilt");
+        return;
+    }
+    auto records_size = std::uint64_t{ header->count } * sizeof(Record);
+    if (sizeof(Header) + records_size + header->pool_size != map_size) {
+        throw std::runtime_error{ "file size does not match the header" };
+    }
+    auto* pool = base + sizeof(Header) + records_size;
+    auto view = [pool,pool_size=header->pool_size](Str str) {
+        if (std::uint64_t{ str.offset } + str.size > pool_size) {
+            throw std::runtime_error{ "string is out of bounds" };
+        }
+        return std::string_view{ pool + str.offset, str.size };
+    };
+    if (view(header->key) != key) {
+        Log::info("Desktop index was built for different language, it will be rebuilt");
+        return;
+    }
+    auto* begin = reinterpret_cast<const Record*>(base + sizeof(Header));
+    records.reserve(header->count);
+    for (auto* record = begin; record != begin + header->count; ++record) {
+        for (auto && field: record->fields) {
+            view(field); // validate
+        }
+        records.emplace(view(record->path), record);
+    }
+    records_count = header->count;
+    saved_count = records_count;
+}
+
+bool DesktopIndex::stat_(const fs::path& path, Stamp& stamp) const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    stamp.mtime = std::int64_t{ st.st_mtim.tv_sec } * 1'000'000'000 + st.st_mtim.tv_nsec;
+    stamp.size = st.st_size;
+    return true;
+}
+
+const DesktopIndex::Record* DesktopIndex::find_(const std::string& path, Stamp stamp) {
+    auto iter = records.find(path);
+    if (iter == records.end()) {
+        return nullptr;
+    }
+    auto* record = iter->second;
+    if (record->stamp.mtime != stamp.mtime || record->stamp.size != stamp.size) {
+        return nullptr;
+    }
+    std::lock_guard lock{ live_mutex };
+    auto && item = live[path];
+    item.stamp = stamp;
+    item.state = static_cast<State>(record->state);
+    item.record = record;
+    item.entry.reset();
+    return record;
+}
+
+DesktopIndex::State DesktopIndex::state_of_(const Record& record) const {
+    switch (record.state) {
+        case Ok:     return Ok;
+        case Hidden: return Hidden;
+        default:     return Error;
+    }
+}
+
+std::unique_ptr<DesktopEntry> DesktopIndex::unpack_(const Record& record) const {
+    auto* pool = static_cast<const char*>(map)
+        + sizeof(Header)
+        + records_count * sizeof(Record);
+    std::unique_ptr<DesktopEntry> entry{ new DesktopEntry{} };
+    for (std::size_t i = 0; i < FIELDS.size(); ++i) {
+        auto && field = record.fields[i];
+        (*entry).*FIELDS[i] = std::string_view{ pool + field.offset, field.size };
+    }
+    entry->terminal = record.terminal;
+    entry->pack();
+    return entry;
+}
+
+void DesktopIndex::remember_(const std::string& path, Stamp stamp, State state, const DesktopEntry* entry) {
+    std::unique_ptr<DesktopEntry> copy{ entry ? new DesktopEntry{ *entry } : nullptr };
+    std::lock_guard lock{ live_mutex };
+    auto && item = live[path];
+    item.stamp = stamp;
+    item.state = state;
+    item.record = nullptr;
+    item.entry = std::move(copy);
+    dirty = true;
+}
+
+void DesktopIndex::on_config_changed() {
+    auto new_key = config.lang;
+    if (new_key == key) {
+        return;
+    }
+    std::lock_guard lock{ live_mutex };
+    key = std::move(new_key);
+    // the mapping stays until the index is destroyed, but none of its records are valid anymore
+    records.clear();
+    live.clear();
+    dirty = true;
+}
+
+void DesktopIndex::save() {
+    std::lock_guard lock{ live_mutex };
+    // entries which were not looked up belong to removed files
+    if (!dirty && live.size() == saved_count) {
+        return;
+    }
+    std::string pool;
+    auto add_string = [&pool](std::string_view str) {
+        Str result{ static_cast<std::uint32_t>(pool.size()), static_cast<std::uint32_t>(str.size()) };
+        pool.append(str);
+        return result;
+    };
+    auto* old_pool = static_cast<const char*>(map)
+        + sizeof(Header)
+        + records_count * sizeof(Record);
+
+    std::vector<Record> new_records;
+    new_records.reserve(live.size());
+    Header header{ MAGIC, VERSION, 0, 0, add_string(key) };
+    for (auto && [path, item]: live) {
+        auto && record = new_records.emplace_back();
+        record.stamp = item.stamp;
+        record.path = add_string(path);
+        record.state = item.state;
+        if (item.record) {
+            record.terminal = item.record->terminal;
+            for (std::size_t i = 0; i < FIELDS.size(); ++i) {
+                auto && field = item.record->fields[i];
+                record.fields[i] = add_string({ old_pool + field.offset, field.size });
+            }
+        } else if (item.entry) {
+            record.terminal = item.entry->terminal;
+            for (std::size_t i = 0; i < FIELDS.size(); ++i) {
+                record.fields[i] = add_string((*item.entry).*FIELDS[i]);
+            }
+        }
+    }
+    header.count = new_records.size();
+    header.pool_size = pool.size();
+
+    // write to a temporary file and then rename it over the old one,
+    // so the mapping stays valid and concurrent readers never see a partial index;
+    // the temporary file is per process, as nwggrid-server & nwggrid may save at the same time
+    auto tmp_file = file;
+    tmp_file += concat(".", std::to_string(getpid()));
+    {
+        std::ofstream out{ tmp_file, std::ios::binary | std::ios::trunc };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(new_records.data()), new_records.size() * sizeof(Record));
+        out.write(pool.data(), pool.size());
+        if (!out) {
+            Log::error("Failed to write desktop index '", tmp_file, "'");
+            out.close();
+            std::error_code ec;
+            fs::remove(tmp_file, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp_file, file, ec);
+    if (ec) {
+        Log::error("Failed to save desktop index '", file, "': ", ec.message());
+        fs::remove(tmp_file, ec);
+        return;
+    }
+    dirty = false;
+    saved_count = new_records.size();
+    Log::info("Desktop index saved, ", new_records.size(), " entries");
+}
@@ -0,0 +1,121 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "filesystem-compat.h"
+#include "nwg_classes.h"
+#include "on_desktop_entry.h"
+
+/* DesktopIndex caches parsed .desktop files between runs.
+ * Records are keyed by the file path and validated by the file mtime & size;
+ * the whole index is discarded if it was built with a different DesktopEntryConfig
+ * (i.e. the language has changed).
+ * TryExec, OnlyShowIn & NotShowIn depend on the environment, so they are checked on each lookup.
+ * The index file is mmap'ed, unchanged entries are unpacked right from the mapping,
+ * the file layout is described in desktop_index.cc
+ * on_desktop_entry may be called from multiple threads at once */
+struct DesktopIndex {
+    enum State: std::uint8_t {
+        Ok = 0,
+        Hidden,
+        Error
+    };
+    // identifies file contents, see stat(2)
+    struct Stamp {
+        std::int64_t  mtime; // nanoseconds
+        std::uint64_t size;
+    };
+    struct Record; // on-disk record, see desktop_index.cc
+
+    DesktopIndex(fs::path file, const DesktopEntryConfig& config);
+    DesktopIndex(const DesktopIndex&) = delete;
+    ~DesktopIndex();
+
+    // same as ::on_desktop_entry, but skips parsing if `path` has not changed since it was indexed
+    template <typename F>
+    void on_desktop_entry(const fs::path& path, F && f);
+    // writes the index back to the file if it has changed since it was loaded
+    void save();
+    // drops all entries if the config they were parsed with has changed, call it after updating the config
+    void on_config_changed();
+private:
+    // entry that was used during this run and will be written on save
+    struct Live {
+        Stamp                         stamp;
+        State                         state;
+        const Record*                 record; // non-null if the entry is loaded from the file
+        std::unique_ptr<DesktopEntry> entry;  // non-null if the entry is freshly parsed & Ok
+    };
+
+    fs::path                                          file;
+    const DesktopEntryConfig&                         config;
+    std::string                                       key;         // serialized config
+    void*                                             map{ nullptr };
+    std::size_t                                       map_size{ 0 };
+    std::size_t                                       records_count{ 0 }; // records in the mapping
+    std::size_t                                       saved_count{ 0 };   // records in the file
+    std::unordered_map<std::string_view, const Record*> records;
+    std::unordered_map<std::string, Live>             live;
+    bool                                              dirty{ false };
+    std::mutex                                        live_mutex;  // guards `live` & `dirty`
+
+    void load_();
+    bool stat_(const fs::path& path, Stamp& stamp) const;
+    // returns the record for `path` if it is up to date, marking it live
+    const Record* find_(const std::string& path, Stamp stamp);
+    State state_of_(const Record& record) const;
+    std::unique_ptr<DesktopEntry> unpack_(const Record& record) const;
+    void remember_(const std::string& path, Stamp stamp, State state, const DesktopEntry* entry);
+};
+
+template <typename F>
+void DesktopIndex::on_desktop_entry(const fs::path& path, F && f) {
+    Stamp stamp;
+    if (!stat_(path, stamp)) {
+        f(OnDesktopEntry::Error_);
+        return;
+    }
+    auto on_entry = [&](std::unique_ptr<DesktopEntry> && entry) {
+        if (shown_in_environment(*entry, config)) {
+            f(std::move(entry));
+        } else {
+            f(OnDesktopEntry::Hidden_);
+        }
+    };
+    if (auto* record = find_(path.native(), stamp)) {
+        switch (state_of_(*record)) {
+            case Ok:     on_entry(unpack_(*record)); break;
+            case Hidden: f(OnDesktopEntry::Hidden_); break;
+            case Error:  f(OnDesktopEntry::Error_); break;
+        }
+        return;
+    }
+    std::unique_ptr<DesktopEntry> entry{ new DesktopEntry{} };
+    switch (parse_desktop_entry(path, config, *entry)) {
+        case DesktopEntryState::Ok:
+            remember_(path.native(), stamp, Ok, entry.get());
+            on_entry(std::move(entry));
+            break;
+        case DesktopEntryState::Hidden:
+            remember_(path.native(), stamp, Hidden, nullptr);
+            f(OnDesktopEntry::Hidden_);
+            break;
+        case DesktopEntryState::Error:
+            remember_(path.native(), stamp, Error, nullptr);
+            f(OnDesktopEntry::Error_);
+            break;
+    }
+}
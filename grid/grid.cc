@@ -8,8 +8,11 @@
  * */
 
 #include <sys/time.h>
+#include <array>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include "nwg_tools.h"
 #include "nwg_classes.h"
@@ -34,30 +37,118 @@ Options:\n\
 -wm <wmname>     window manager name (if can not be detected)\n\
 -i <command>     command executed when gui is shown\n\
 -e <command>     command executed when gui is hidden\n\
+-virtual         draw the grid in a single widget painting only the visible rows, for thousands of entries\n\
 -oneshot         run in the foreground, exit when window is closed\n\
                  generally you should not use this option, use simply `nwggrid` instead\n\
 [requires layer-shell]:\n\
 -layer-shell-layer          {BACKGROUND,BOTTOM,TOP,OVERLAY},         default: OVERLAY\n\
 -layer-shell-exclusive-zone {auto, valid integer (usually -1 or 0)}, default: auto\n";
 
-/* Base class for application drivers, simply calls Application::run */
-struct ApplicationDriver {
-    Glib::RefPtr<Gtk::Application> app;
+namespace {
+    // application dirs set with -d or the default ones
+    std::vector<fs::path> get_dirs(const InputParser& input) {
+        std::vector<fs::path> dirs;
+        if (auto special_dirs = input.getCmdOption("-d"); !special_dirs.empty()) {
+            using namespace std::string_view_literals;
+            // use special dirs specified with -d argument (feature request #122)
+            auto dirs_ = split_string(special_dirs, ":");
+            Log::info("Using custom .desktop files path(s):\n");
+            std::array status { "' [INVALID]\n"sv, "' [OK]\n"sv };
+            for (auto && dir: dirs_) {
+                std::error_code ec;
+                auto is_dir = fs::is_directory(dir, ec) && !ec;
+                Log::plain('\'', dir, status[is_dir]);
+                if (is_dir) {
+                    dirs.emplace_back(dir);
+                }
+            }
+        } else {
+            // get all applications dirs
+            dirs = get_app_dirs();
+        }
+        return dirs;
+    }
+}
+
+/* Applies the server ARGS (or the startup ones) without restarting, see GridInstance::reload.
+ * The style, background, columns, commands & icon size are applied in place,
+ * the entries are rescanned & diffed, so only the changed ones are updated */
+struct Reloader {
+    GridConfig&                    config;
+    GridWindow&                    window;
+    IconProvider&                  icons;
+    EntriesModel&                  table;
+    EntriesManager&                entries;
+    Glib::RefPtr<Gtk::CssProvider> provider;
+    Glib::RefPtr<Gdk::Screen>      screen;
+    Glib::RefPtr<Gtk::Settings>    settings;
+    fs::path                       config_dir;
+    std::vector<std::string>       startup_args; // argv[0] & the server args
+
+    void operator()(const std::vector<std::string>& args) {
+        // InputParser keeps views of the arguments, they live until the end of the reload
+        std::vector<std::string> strings{ startup_args.front() };
+        if (args.empty()) {
+            strings = startup_args;
+        } else {
+            strings.insert(strings.end(), args.begin(), args.end());
+        }
+        std::vector<char*> argv;
+        for (auto && arg: strings) {
+            argv.push_back(arg.data());
+        }
+        InputParser input{ static_cast<int>(argv.size()), argv.data() };
+        GridConfig new_config{ input, screen, config_dir };
+
+        settings->property_gtk_theme_name() = new_config.theme;
+        auto css_file = setup_css_file("nwggrid", config_dir, new_config.css_filename);
+        try {
+            provider->load_from_path(css_file);
+        } catch (const Glib::Error& e) {
+            throw std::runtime_error{ concat("failed to load css file '", css_file.native(), "': ", e.what().raw()) };
+        }
+        Log::info("Using css file \'", css_file, "\'");
+        config.theme = std::move(new_config.theme);
+        config.css_filename = std::move(new_config.css_filename);
+
+        config.background_color = new_config.background_color;
+        window.set_background_color(config.background_color);
+        window.queue_draw();
+        if (new_config.num_col != config.num_col) {
+            window.set_columns(new_config.num_col);
+        }
+        config.command_show = std::move(new_config.command_show);
+        config.command_hide = std::move(new_config.command_hide);
+        if (new_config.pins != config.pins || new_config.favs != config.favs || new_config.virtual_grid != config.virtual_grid) {
+            Log::warn("'-p', '-f' & '-virtual' take effect after restart");
+        }
+
+        if (new_config.icon_size != config.icon_size) {
+            config.icon_size = new_config.icon_size;
+            icons.set_icon_size(config.icon_size);
+            table.reload_icons();
+        }
 
-    ApplicationDriver(const Glib::RefPtr<Gtk::Application>& app): app{ app } {
-        // intentionally left blank
+        // a new language invalidates all entries, otherwise only the changed files are parsed
+        config.lang = std::move(new_config.lang);
+        config.term = std::move(new_config.term);
+        auto dirs = get_dirs(input);
+        entries.reload(dirs);
+        Log::info("Reloaded, locale: ", config.lang);
     }
-    virtual ~ApplicationDriver() = default;
-    virtual int run() { return app->run(); }
 };
 
-/* Keeps the application alive when the window is closed, registers & deregisters */
+/* Keeps the application alive when the window is closed, registers & deregisters,
+ * listens for the `nwggrid -client` commands */
 struct ServerDriver: public ApplicationDriver {
     GridInstance instance;
+    // the instance terminates the running server, which removes its socket, so it goes first
+    SocketServer control;
 
     ServerDriver(const Glib::RefPtr<Gtk::Application>& app, GridWindow& window):
         ApplicationDriver{ app },
-        instance{ *app.get(), window, "nwggrid-server" }
+        instance{ *app.get(), window, "nwggrid-server" },
+        control{ get_socket_path(), [this](auto && request) { instance.on_command(request); } }
     {
         app->hold();
     }
@@ -161,25 +252,7 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        std::vector<fs::path> dirs;
-        if (auto special_dirs = input.getCmdOption("-d"); !special_dirs.empty()) {
-            using namespace std::string_view_literals;
-            // use special dirs specified with -d argument (feature request #122)
-            auto dirs_ = split_string(special_dirs, ":");
-            Log::info("Using custom .desktop files path(s):\n");
-            std::array status { "' [INVALID]\n"sv, "' [OK]\n"sv };
-            for (auto && dir: dirs_) {
-                std::error_code ec;
-                auto is_dir = fs::is_directory(dir, ec) && !ec;
-                Log::plain('\'', dir, status[is_dir]);
-                if (is_dir) {
-                    dirs.emplace_back(dir);
-                }
-            }
-        } else {
-            // get all applications dirs
-            dirs = get_app_dirs();
-        }
+        auto dirs = get_dirs(input);
 
         gettimeofday(&tp, NULL);
         long int commons_ms  = tp.tv_sec * 1000 + tp.tv_usec / 1000;
@@ -204,11 +277,28 @@ int main(int argc, char *argv[]) {
         format("\tmodels: ", window_ms, model_ms);
 
         std::unique_ptr<ApplicationDriver> driver;
+        GridInstance* instance;
         if (config.oneshot) {
-            driver.reset(new OneshotDriver{ app, window });
+            auto* oneshot = new OneshotDriver{ app, window };
+            driver.reset(oneshot);
+            instance = &oneshot->instance;
         } else {
-            driver.reset(new ServerDriver{ app, window });
+            auto* server = new ServerDriver{ app, window };
+            driver.reset(server);
+            instance = &server->instance;
         }
+        instance->reload = Reloader {
+            config,
+            window,
+            icon_provider,
+            table,
+            entries_provider,
+            provider,
+            screen,
+            settings,
+            config_dir,
+            std::vector<std::string>(argv, argv + argc)
+        };
         return driver->run();
     } catch (const Glib::Error& err) {
         // Glib::ustring performs conversion with respect to locale settings
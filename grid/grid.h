@@ -7,6 +7,8 @@
  * */
 #pragma once
 
+#include <functional>
+
 #include <gtkmm.h>
 #include <glibmm/ustring.h>
 
@@ -15,6 +17,12 @@
 #include "nwgconfig.h"
 #include "filesystem-compat.h"
 #include "nwg_classes.h"
+#include "nwg_socket.h"
+#include "nwg_tools.h"
+#include "nwg_trace.h"
+#include "desktop_ids.h"
+#include "slab.h"
+#include "grid_search.h"
 
 namespace ns = nlohmann;
 
@@ -51,41 +59,47 @@ struct Stats {
     Stats() = default;
 };
 
+class GridBox;
+
 struct Entry {
     std::string_view desktop_id;
-    // no point making it string_view as Glib::spawn_command_async takes const string&
-    // making it string& however breaks move ctors/assignments
-    std::string*     exec;
+    DesktopIds::Slot slot;           // of desktop_id, indexes the per-id data
     Stats            stats;
+    GridBox*         box{ nullptr }; // box displaying the entry
 
-    // TODO: should we store it separately?
-    std::unique_ptr<DesktopEntry> desktop_entry_;
+    // stored inline, its strings are in a single block
+    DesktopEntry     desktop_entry_;
 
-    Entry(std::string_view id, Stats stats, std::unique_ptr<DesktopEntry> entry):
-        desktop_id{ id }, exec{ &entry->exec }, stats{ stats }, desktop_entry_{ std::move(entry) }
+    Entry(std::string_view id, DesktopIds::Slot slot, Stats stats, DesktopEntry entry):
+        desktop_id{ id }, slot{ slot }, stats{ stats }, desktop_entry_{ std::move(entry) }
     {
         // intentionally left blank
     }
     auto & desktop_entry() {
-        return *desktop_entry_;
+        return desktop_entry_;
     }
 };
 
 class GridBox : public Gtk::Button {
 public:
-    /* name, comment, desktop-id, index */
-    GridBox(Glib::ustring, Glib::ustring, Entry& entry);
+    // takes the name & comment from the entry
+    GridBox(Entry& entry);
     GridBox(GridBox&&) = default;
     ~GridBox() = default;
     bool on_button_press_event(GdkEventButton*) override;
     bool on_focus_in_event(GdkEventFocus*) override;
     void on_enter() override;
     void on_activate() override;
+    // updates the name, the comment, the search key & the label after the entry has changed
+    void update_text();
 
     Glib::ustring    name;
     Glib::ustring    comment;
+    SearchKey        search_key; // see AppBoxes::filter
 
     Entry* entry;
+private:
+    void set_display_name_();
 };
 
 struct GridConfig: public Config {
@@ -98,11 +112,13 @@ struct GridConfig: public Config {
     std::size_t num_col{ 6 }; // number of grid columns
     fs::path pinned_file;     // file with pins
     fs::path cached_file;     // file with favs
+    fs::path index_file;      // file with parsed .desktop files
     int icon_size{ 72 };
     RGBA background_color;
     bool oneshot{ false };    // run in foreground, exit when window is closed
     std::string command_show;
     std::string command_hide;
+    bool virtual_grid{ false }; // draw the grid with GridView rather than FlowBoxes
 };
 
 class AbstractBoxes {
@@ -124,6 +140,7 @@ public:
 class BoxesModel: public AbstractBoxes, public Gio::ListModel, public Glib::Object {
 public:
     virtual ~BoxesModel() = default;
+    // linear, pinned & favourites are a handful of boxes; AppBoxes finds its boxes by name
     virtual void erase(GridBox& box) override {
         if (auto iter = std::find(boxes.begin(), boxes.end(), &box); iter != boxes.end()) {
             auto pos = std::distance(boxes.begin(), iter);
@@ -132,16 +149,6 @@ public:
             items_changed(pos, 1, 0);
         }
     }
-    virtual void update(GridBox& from, GridBox& to) {
-        if (auto iter = std::find(boxes.begin(), boxes.end(), &from); iter != boxes.end()) {
-            auto pos = std::distance(boxes.begin(), iter);
-            // two references required, but why?
-            to.reference();
-            to.reference();
-            *iter = &to;
-            items_changed(pos, 1, 1);
-        }
-    }
 protected:
     BoxesModel(): Glib::ObjectBase(typeid(BoxesModel)), Gio::ListModel() {}
     GType get_item_type_vfunc() override {
@@ -227,77 +234,74 @@ public:
 class AppBoxes: public BoxesModel, public Create<AppBoxes> {
     friend struct Create<AppBoxes>; // permit Create to access a protected constructor
 private:
-    std::vector<GridBox*> all_boxes; // unsorted & unfiltered boxes
-    Glib::ustring search_criteria;
+    std::vector<GridBox*> all_boxes; // sorted by name
+    SearchQuery           query{ "" };
+    // buffers reused between searches
+    std::vector<std::pair<int, GridBox*>> ranked; // matching boxes with their scores
+    std::vector<GridBox*>                 next;   // boxes to show
+    bool                                  refilter_pending{ false }; // matching boxes came while filtered, see flush
 protected:
     AppBoxes(): Glib::ObjectBase(typeid(AppBoxes)) {}
-    void add_if_matches(GridBox* box) {
-        if (box->name.casefold().find(search_criteria) != Glib::ustring::npos) {
-            container_add_sorted(boxes, box, [](auto* a, auto* b) {
-                return a->name.compare(b->name) > 0;
-            });
-        }
-    }
+    // the first of `sorted` (by name) not less than `name`, `box` is taken to be named `name`:
+    // it may be out of place, as its name has changed, see reposition
+    static std::vector<GridBox*>::iterator lower_bound_(std::vector<GridBox*>& sorted, GridBox& box, const Glib::ustring& name);
+    // `box` in `sorted` (by name) or its end, `name` is the one `box` is sorted by
+    static std::vector<GridBox*>::iterator find_(std::vector<GridBox*>& sorted, GridBox& box, const Glib::ustring& name);
+    // inserts `box` keeping `sorted` sorted by name, returns its position
+    static std::size_t insert_(std::vector<GridBox*>& sorted, GridBox& box);
+    // ranks `candidates` matching the query into `next` and updates `boxes` to it
+    void refilter_(const std::vector<GridBox*>& candidates);
+    // replaces `boxes` with candidates[i] satisfying keep(i), notifying only about the changed ranges;
+    // `boxes` must be a subsequence of `candidates`
+    template <typename Keep>
+    void transition_(const std::vector<GridBox*>& candidates, Keep && keep);
 public:
     void add(GridBox& box) override {
         // TODO: ensure the box does not exist before insertion for all *Boxes classes
-        all_boxes.push_back(&box);
-        if (search_criteria.length() == 0 || (box.name.casefold().find(search_criteria) != Glib::ustring::npos)) {
-            auto pos = container_add_sorted(boxes, &box, [](auto* a, auto* b) {
-                return a->name.compare(b->name) > 0;
-            });
+        insert_(all_boxes, box);
+        if (!is_filtered()) {
+            auto pos = insert_(boxes, box);
             items_changed(pos, 0, 1);
+        } else if (fuzzy_score(query, box.search_key) != NO_MATCH) {
+            refilter_(all_boxes);
         }
     }
-    void erase(GridBox& box) override {
-        // erasing from filtered boxes will decrease reference count by 1, destroying object
-        // but we want it alive to remove it from all_boxes and then to destroy it ourselves
-        box.reference();
-        // erase from filtered boxes
-        BoxesModel::erase(box);
-        // erase from all boxes
-        if (auto to_erase_2 = std::remove(all_boxes.begin(), all_boxes.end(), &box); to_erase_2 != all_boxes.end()) {
-            all_boxes.erase(to_erase_2);
+    // the box is found by binary search by name, unless it is ranked by the search
+    void erase(GridBox& box) override;
+    // same as add, but while filtered the boxes are ranked on `flush`, so loading a batch costs one refilter
+    void add_deferred(GridBox& box) {
+        if (!is_filtered()) {
+            add(box);
+            return;
         }
+        insert_(all_boxes, box);
+        refilter_pending |= fuzzy_score(query, box.search_key) != NO_MATCH;
     }
-    void filter(const Glib::ustring& criteria) {
-        auto criteria_ = criteria.casefold();
-        if (search_criteria != criteria_) {
-            search_criteria = criteria_;
-            // TODO: only update actually removed/inserted entries
-            auto old_size = boxes.size();
-            if (search_criteria.length() > 0) {
-                for (auto && box: boxes) {
-                    box->reference();
-                }
-                boxes.clear();
-                for (auto && box: all_boxes) {
-                    box->reference();
-                    add_if_matches(box);
-                }
-            } else {
-                boxes = all_boxes;
-                std::sort(boxes.begin(), boxes.end(), [](auto* a, auto* b) {
-                    return a->name.compare(b->name) < 0;
-                });
-                for (auto && box: all_boxes) {
-                    box->reference();
-                    box->reference();
-                }
-            }
-            items_changed(0, old_size, boxes.size());
+    // ranks the boxes added or repositioned while filtered
+    void flush() {
+        if (refilter_pending) {
+            refilter_(all_boxes);
         }
     }
+    // keeps `box` sorted after its name or search key has changed, the model changes only if the box moves;
+    // while filtered, it is ranked on `flush`. `old_name` is the name the box was sorted by
+    void reposition(GridBox& box, const Glib::ustring& old_name);
+    /* Shows the boxes fuzzy-matching `criteria`, best matches first (see grid_search.h),
+     * or all boxes sorted by name if the criteria is empty.
+     * If the criteria only extends the previous one, only the currently shown boxes are checked */
+    void filter(const Glib::ustring& criteria);
     bool is_filtered() {
-        return search_criteria.length() > 0;
+        return !query.empty();
     }
 };
 
+class GridView;
 
 class GridWindow : public PlatformWindow {
     public:
         GridWindow(GridConfig& config);
         GridWindow(const GridWindow&) = delete;
+        ~GridWindow();
 
         Gtk::SearchEntry searchbox;              // Search apps
         Gtk::Label description;                  // To display .desktop entry Comment field at the bottom
@@ -313,25 +317,47 @@ class GridWindow : public PlatformWindow {
         Gtk::HBox favs_hbox;
         Gtk::HBox apps_hbox;
         Gtk::ScrolledWindow scrolled_window;
+        Gtk::HBox view_hbox;                     // GridView & its scrollbar, replace scrolled_window if virtual_grid
+        Gtk::Scrollbar view_scrollbar;
         GridConfig&           config;
+        // from the show request to the window being mapped, drawn & receiving the first key press
+        Trace::Timeline       show_trace;
 
         template <typename ... Args>
         GridBox& emplace_box(Args&& ... args);      // emplace box
-        void update_box_by_id(std::string_view desktop_id, GridBox&&);
-        void remove_box_by_desktop_id(std::string_view desktop_id);
+        // updates the box after the texts of its entry have changed, see GridBox::update_text
+        void update_box(GridBox& box, bool name_changed);
+        void remove_box(GridBox& box);
 
         void build_grids();
         void toggle_pinned(GridBox& box);
         void set_description(const Glib::ustring&);
         void save_cache();
         void run_box(GridBox& box);
-
-        std::string& exec_of(const GridBox& box) {
-            return *box.entry->exec;
+        // shows the window with the search box set to `query`
+        void show_with_query(const Glib::ustring& query);
+        void set_columns(std::size_t num_col);
+        // redraws the grid after IconProvider has set the icons
+        void on_icons_loaded();
+        // human-readable counters, one per line
+        std::string stats();
+
+        std::string_view exec_of(const GridBox& box) {
+            return box.entry->desktop_entry().exec;
         }
         Stats& stats_of(const GridBox& box) {
             return box.entry->stats;
         }
+        // calls `f` for each displayed box, in the order they are displayed
+        template <typename F>
+        void for_each_displayed_box(F && f) {
+            AbstractBoxes* models[] { pinned_boxes.get(), fav_boxes.get(), apps_boxes.get() };
+            for (auto* boxes: models) {
+                for (auto* box: *boxes) {
+                    f(*box);
+                }
+            }
+        }
     protected:
         //Override default signal handler:
         bool on_key_press_event(GdkEventKey*) override;
@@ -339,11 +365,17 @@ class GridWindow : public PlatformWindow {
 	void on_hide() override;
         bool on_delete_event(GdkEventAny*) override;
         bool on_button_press_event(GdkEventButton*) override;
+#ifdef NWG_TRACING
+        bool on_map_event(GdkEventAny*) override;
+        bool on_draw(const Cairo::RefPtr<Cairo::Context>&) override;
+#endif
     private:
-        std::list<GridBox>  all_boxes {}; // stores all applications buttons
+        Slab<GridBox>       all_boxes {}; // stores all applications buttons
+        std::vector<Slab<GridBox>::Handle> boxes_by_slot; // all_boxes by the slot of their entry
         Glib::RefPtr<AppBoxes> apps_boxes;   // common boxes (possibly filtered)
         Glib::RefPtr<FavBoxes> fav_boxes;    // favourites (most clicked)
         Glib::RefPtr<PinnedBoxes> pinned_boxes; // boxes pinned by user
+        std::unique_ptr<GridView> grid_view;    // draws the boxes if virtual_grid, the FlowBoxes are unused then
 
         bool pins_changed = false;
         bool favs_changed = false;
@@ -355,7 +387,13 @@ class GridWindow : public PlatformWindow {
 
 template <typename ... Args>
 GridBox& GridWindow::emplace_box(Args&& ... args) {
-    auto& ab = this -> all_boxes.emplace_back(std::forward<Args>(args)...);
+    auto handle = this -> all_boxes.emplace(std::forward<Args>(args)...);
+    auto& ab = *this -> all_boxes.get(handle);
+    auto slot = ab.entry->slot;
+    if (slot >= boxes_by_slot.size()) {
+        boxes_by_slot.resize(slot + 1);
+    }
+    boxes_by_slot[slot] = handle;
     ab.reference();
     ab.reference();
     AbstractBoxes* boxes = apps_boxes.get();
@@ -365,7 +403,12 @@ GridBox& GridWindow::emplace_box(Args&& ... args) {
     } else if (stats.favorite) {
         boxes = fav_boxes.get();
     }
-    boxes->add(ab);
+    if (boxes == apps_boxes.get()) {
+        // the batch is ranked once on build_grids
+        apps_boxes->add_deferred(ab);
+    } else {
+        boxes->add(ab);
+    }
     return ab;
 }
 
@@ -377,6 +420,9 @@ struct CacheEntry {
 
 struct GridInstance: public Instance {
     GridWindow& window;
+    // re-reads the config & style and rescans the entries with the server ARGS, or the startup ones if empty;
+    // throws on failure, set by nwggrid-server
+    std::function<void(const std::vector<std::string>& args)> reload;
 
     GridInstance(Gtk::Application& app, GridWindow& window, std::string_view name):
         Instance{ app, name }, window{ window }
@@ -388,12 +434,15 @@ struct GridInstance: public Instance {
      * To handle this problem GridInstance overrides handlers
      * to call Application::release
      */
-    void on_sighup() override;  // reload
+    void on_sighup() override;  // reload with the startup args
     void on_sigint() override;  // save & exit
     void on_sigterm() override;  // save & exit
     void on_sigusr1() override; // show
+    // handles the control socket request, see grid_client.cc for the commands
+    void on_command(SocketServer::Request& request);
     ~GridInstance() {
         window.save_cache();
+        Trace::dump(get_runtime_dir() / "nwggrid.trace");
     }
 };
 
@@ -403,3 +452,5 @@ struct GridInstance: public Instance {
 std::vector<fs::path>       get_app_dirs(void);
 std::vector<std::string>    get_pinned(const fs::path& pinned_file);
 std::vector<CacheEntry>     get_favourites(ns::json&&, int);
+// nwggrid-server listens on this socket for the control commands
+fs::path                    get_socket_path();
@@ -14,11 +14,14 @@
  * (https://stackoverflow.com/questions/3908565/how-to-make-gtk-window-background-transparent)
  * Re-worked for Gtkmm 3.0 by Louis Melahn, L.C. January 31, 2014.
  * */
+#include <algorithm>
 #include <fstream>
+#include <functional>
 
 #include "charconv-compat.h"
 #include "nwg_tools.h"
 #include "grid.h"
+#include "grid_view.h"
 
 GridConfig::GridConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen>& screen, const fs::path& config_dir):
     Config{ parser, "~nwggrid", "~nwggrid", screen },
@@ -52,15 +55,14 @@ GridConfig::GridConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen
         }
     }
 
-    if (pins || favs) {
-        auto cache_home = get_cache_home();
-        if (pins) {
-            pinned_file = cache_home / "nwg-pin-cache";
-        }
-        if (favs) {
-            cached_file = cache_home / "nwg-fav-cache";
-        }
+    auto cache_home = get_cache_home();
+    if (pins) {
+        pinned_file = cache_home / "nwg-pin-cache";
+    }
+    if (favs) {
+        cached_file = cache_home / "nwg-fav-cache";
     }
+    index_file = cache_home / "nwg-grid-index";
 
     if (auto i_size = parser.getCmdOption("-s"); !i_size.empty()){
         icon_size = parse_icon_size(i_size);
@@ -69,6 +71,7 @@ GridConfig::GridConfig(const InputParser& parser, const Glib::RefPtr<Gdk::Screen
 
     command_show = parser.getCmdOption("-i");
     command_hide = parser.getCmdOption("-e");
+    virtual_grid = parser.cmdOptionExists("-virtual");
 }
 
 static Gtk::Widget* make_widget(const Glib::RefPtr<Glib::Object>& object) {
@@ -100,11 +103,15 @@ GridWindow::GridWindow(GridConfig& config):
     pinned_boxes = PinnedBoxes::create();
     fav_boxes = FavBoxes::create();
 
-    // doesn't compile with lambda due to sigc bug, must use free function
-    Gtk::FlowBox::SlotCreateWidget<Glib::Object> make_widget_{ &make_widget };
-    pinned_grid.bind_model(pinned_boxes, make_widget_);
-    favs_grid.bind_model(fav_boxes, make_widget_);
-    apps_grid.bind_model(apps_boxes, make_widget_);
+    if (config.virtual_grid) {
+        grid_view = std::make_unique<GridView>(*this, *pinned_boxes.get(), *fav_boxes.get(), *apps_boxes.get());
+    } else {
+        // doesn't compile with lambda due to sigc bug, must use free function
+        Gtk::FlowBox::SlotCreateWidget<Glib::Object> make_widget_{ &make_widget };
+        pinned_grid.bind_model(pinned_boxes, make_widget_);
+        favs_grid.bind_model(fav_boxes, make_widget_);
+        apps_grid.bind_model(apps_boxes, make_widget_);
+    }
 
     description.set_ellipsize(Pango::ELLIPSIZE_END);
     description.set_text("");
@@ -135,8 +142,16 @@ GridWindow::GridWindow(GridConfig& config):
     apps_hbox.pack_start(apps_grid, Gtk::PACK_EXPAND_PADDING);
     inner_vbox.pack_start(apps_hbox, Gtk::PACK_SHRINK);
 
-    outer_vbox.pack_start(scrolled_window, Gtk::PACK_EXPAND_WIDGET);
-    scrolled_window.show_all_children();
+    if (grid_view) {
+        view_scrollbar.set_orientation(Gtk::ORIENTATION_VERTICAL);
+        view_scrollbar.set_adjustment(grid_view->get_vadjustment());
+        view_hbox.pack_start(*grid_view, Gtk::PACK_EXPAND_WIDGET);
+        view_hbox.pack_start(view_scrollbar, Gtk::PACK_SHRINK);
+        outer_vbox.pack_start(view_hbox, Gtk::PACK_EXPAND_WIDGET);
+    } else {
+        outer_vbox.pack_start(scrolled_window, Gtk::PACK_EXPAND_WIDGET);
+        scrolled_window.show_all_children();
+    }
 
     outer_vbox.pack_start(description, Gtk::PACK_SHRINK);
 
@@ -145,6 +160,8 @@ GridWindow::GridWindow(GridConfig& config):
     this -> show_all_children();
 }
 
+GridWindow::~GridWindow() = default;
+
 bool GridWindow::on_button_press_event(GdkEventButton *event) {
     (void) event; // suppress warning
 
@@ -153,6 +170,7 @@ bool GridWindow::on_button_press_event(GdkEventButton *event) {
 }
 
 bool GridWindow::on_key_press_event(GdkEventKey* key_event) {
+    show_trace.mark("show.first-key");
     switch (key_event->keyval) {
         case GDK_KEY_Escape:
             this->hide();
@@ -216,8 +234,209 @@ inline auto build_grid = [](auto& grid, auto& container, auto num_col) {
     disable_flowbox_child_focus(grid);
 };
 
+void AppBoxes::filter(const Glib::ustring& criteria) {
+    SearchQuery new_query{ criteria.raw() };
+    if (new_query.text == query.text) {
+        return;
+    }
+    auto narrowing = !query.empty() && query.is_subsequence_of(new_query);
+    query = std::move(new_query);
+    // the pending boxes are not among the shown ones yet
+    refilter_(narrowing && !refilter_pending ? boxes : all_boxes);
+}
+
+auto AppBoxes::lower_bound_(std::vector<GridBox*>& sorted, GridBox& box, const Glib::ustring& name)
+    -> std::vector<GridBox*>::iterator
+{
+    return std::lower_bound(sorted.begin(), sorted.end(), name, [&box](GridBox* other, const Glib::ustring& name) {
+        return (other == &box ? name : other->name).compare(name) < 0;
+    });
+}
+
+auto AppBoxes::find_(std::vector<GridBox*>& sorted, GridBox& box, const Glib::ustring& name)
+    -> std::vector<GridBox*>::iterator
+{
+    // the boxes named the same follow each other
+    for (auto iter = lower_bound_(sorted, box, name); iter != sorted.end(); ++iter) {
+        if (*iter == &box) {
+            return iter;
+        }
+        if ((*iter)->name.compare(name) != 0) {
+            break;
+        }
+    }
+    return sorted.end();
+}
+
+std::size_t AppBoxes::insert_(std::vector<GridBox*>& sorted, GridBox& box) {
+    // before the boxes named the same, as container_add_sorted did
+    auto iter = sorted.insert(lower_bound_(sorted, box, box.name), &box);
+    return std::distance(sorted.begin(), iter);
+}
+
+void AppBoxes::erase(GridBox& box) {
+    // erasing from filtered boxes will decrease reference count by 1, destroying object
+    // but we want it alive to remove it from all_boxes and then to destroy it ourselves
+    box.reference();
+    // erase from the shown boxes, they are sorted by name unless ranked by the search
+    auto iter = is_filtered() ? std::find(boxes.begin(), boxes.end(), &box) : find_(boxes, box, box.name);
+    if (iter != boxes.end()) {
+        auto pos = std::distance(boxes.begin(), iter);
+        boxes.erase(iter);
+        box.reference();
+        items_changed(pos, 1, 0);
+    }
+    // erase from all boxes
+    if (auto all = find_(all_boxes, box, box.name); all != all_boxes.end()) {
+        all_boxes.erase(all);
+    }
+}
+
+void AppBoxes::reposition(GridBox& box, const Glib::ustring& old_name) {
+    auto iter = find_(all_boxes, box, old_name);
+    if (iter == all_boxes.end()) {
+        // pinned or favourite
+        return;
+    }
+    all_boxes.erase(iter);
+    auto to = insert_(all_boxes, box);
+    if (is_filtered()) {
+        // the ranking may change, the boxes of a batch are ranked at once
+        refilter_pending = true;
+        return;
+    }
+    // the shown boxes are all_boxes
+    auto from = std::distance(boxes.begin(), find_(boxes, box, old_name));
+    if (from == to) {
+        return;
+    }
+    // the references are taken as in transition_
+    box.reference();
+    boxes.erase(boxes.begin() + from);
+    items_changed(from, 1, 0);
+    box.reference();
+    boxes.insert(boxes.begin() + to, &box);
+    items_changed(to, 0, 1);
+}
+
+template <typename Keep>
+void AppBoxes::transition_(const std::vector<GridBox*>& candidates, Keep && keep) {
+    // walk the candidates and the shown boxes in parallel, applying the changes run by run,
+    // so that the model is consistent on each items_changed
+    std::vector<GridBox*> inserted;
+    std::size_t pos = 0;     // position in `boxes`
+    std::size_t removed = 0; // boxes to remove at `pos`
+    auto flush = [&]() {
+        if (removed == 0 && inserted.empty()) {
+            return;
+        }
+        for (std::size_t i = pos; i < pos + removed; ++i) {
+            boxes[i]->reference();
+        }
+        for (auto* box: inserted) {
+            box->reference();
+        }
+        auto begin = boxes.begin() + pos;
+        boxes.insert(boxes.erase(begin, begin + removed), inserted.begin(), inserted.end());
+        items_changed(pos, removed, inserted.size());
+        pos += inserted.size();
+        removed = 0;
+        inserted.clear();
+    };
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        auto* box = candidates[i];
+        auto shown = pos + removed < boxes.size() && boxes[pos + removed] == box;
+        auto stays = keep(i);
+        if (shown && stays) {
+            flush();
+            ++pos;
+        } else if (shown) {
+            ++removed;
+        } else if (stays) {
+            inserted.push_back(box);
+        }
+    }
+    flush();
+}
+
+void AppBoxes::refilter_(const std::vector<GridBox*>& candidates) {
+    refilter_pending = false;
+    next.clear();
+    if (query.empty()) {
+        next = all_boxes;
+    } else {
+        ranked.clear();
+        for (auto* box: candidates) {
+            if (auto score = fuzzy_score(query, box->search_key); score != NO_MATCH) {
+                // frequently launched apps go first, unless the others match much better
+                for (auto clicks = box->entry->stats.clicks; clicks > 0; clicks >>= 1) {
+                    score += 4;
+                }
+                ranked.emplace_back(score, box);
+            }
+        }
+        std::sort(ranked.begin(), ranked.end(), [](auto && a, auto && b) {
+            if (a.first != b.first) {
+                return a.first > b.first;
+            }
+            if (auto order = a.second->name.compare(b.second->name); order != 0) {
+                return order < 0;
+            }
+            return std::less<GridBox*>{}(a.second, b.second);
+        });
+        for (auto && [score, box]: ranked) {
+            next.push_back(box);
+        }
+    }
+
+    // boxes which keep their relative order (longest increasing subsequence of their new positions)
+    // stay in place, the rest are removed and then the missing ones are inserted
+    std::vector<std::pair<GridBox*, std::size_t>> next_positions;
+    next_positions.reserve(next.size());
+    for (std::size_t i = 0; i < next.size(); ++i) {
+        next_positions.emplace_back(next[i], i);
+    }
+    std::sort(next_positions.begin(), next_positions.end());
+    auto position_of = [&next_positions](GridBox* box) -> std::ptrdiff_t {
+        auto iter = std::lower_bound(next_positions.begin(), next_positions.end(), std::make_pair(box, std::size_t{ 0 }));
+        if (iter == next_positions.end() || iter->first != box) {
+            return -1;
+        }
+        return iter->second;
+    };
+    // lis[k] is the index in `boxes` of the smallest tail of an increasing subsequence of length k + 1,
+    // prev links the subsequences back
+    std::vector<std::size_t> lis;
+    std::vector<std::ptrdiff_t> positions(boxes.size()), prev(boxes.size(), -1);
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+        positions[i] = position_of(boxes[i]);
+        if (positions[i] < 0) {
+            continue;
+        }
+        auto iter = std::lower_bound(lis.begin(), lis.end(), positions[i], [&positions](auto j, auto pos) {
+            return positions[j] < pos;
+        });
+        if (iter != lis.begin()) {
+            prev[i] = *(iter - 1);
+        }
+        if (iter == lis.end()) {
+            lis.push_back(i);
+        } else {
+            *iter = i;
+        }
+    }
+    std::vector<bool> stays(boxes.size(), false);
+    for (auto i = lis.empty() ? std::ptrdiff_t{ -1 } : std::ptrdiff_t(lis.back()); i >= 0; i = prev[i]) {
+        stays[i] = true;
+    }
+    auto old_boxes = boxes;
+    transition_(old_boxes, [&stays](auto i) { return stays[i]; });
+    transition_(next, [](auto) { return true; });
+}
+
 /* Called each time `search_entry` changes, rebuilds `apps_grid` according to search criteria */
 void GridWindow::filter_view() {
+    Trace::Span span{ "filter" };
     apps_boxes->filter(searchbox.get_text());
     this -> refresh_separators();
     this -> focus_first_box();
@@ -237,6 +456,7 @@ void GridWindow::refresh_separators() {
 }
 
 void GridWindow::build_grids() {
+    apps_boxes->flush();
     auto num_col = config.num_col;
     build_grid(this->pinned_grid, *pinned_boxes.get(), num_col);
     build_grid(this->favs_grid, *fav_boxes.get(), num_col);
@@ -251,6 +471,10 @@ void GridWindow::build_grids() {
 }
 
 void GridWindow::focus_first_box() {
+    if (grid_view) {
+        grid_view->select_first(apps_boxes->is_filtered());
+        return;
+    }
     if (apps_boxes->is_filtered() && apps_boxes->size()) {
         apps_boxes->front()->grab_focus();
     } else {
@@ -266,6 +490,42 @@ void GridWindow::focus_first_box() {
     }
 }
 
+void GridWindow::show_with_query(const Glib::ustring& query) {
+    show(hint::Fullscreen);
+    // on_show clears the search box
+    searchbox.set_text(query);
+    searchbox.set_position(-1);
+    // don't wait for the delayed search-changed signal
+    filter_view();
+}
+
+void GridWindow::set_columns(std::size_t num_col) {
+    config.num_col = num_col;
+    refresh_max_children_per_line(pinned_grid, *pinned_boxes.get(), num_col);
+    refresh_max_children_per_line(favs_grid, *fav_boxes.get(), num_col);
+    refresh_max_children_per_line(apps_grid, *apps_boxes.get(), num_col);
+    if (grid_view) {
+        grid_view->refresh();
+    }
+}
+
+void GridWindow::on_icons_loaded() {
+    if (grid_view) {
+        grid_view->icons_changed();
+    }
+}
+
+std::string GridWindow::stats() {
+    return concat(
+        "entries: ", std::to_string(all_boxes.size()), '\n',
+        "pinned: ", std::to_string(pinned_boxes->size()), '\n',
+        "favourites: ", std::to_string(fav_boxes->size()), '\n',
+        "shown: ", std::to_string(apps_boxes->size()), '\n',
+        "columns: ", std::to_string(config.num_col), '\n',
+        "visible: ", get_visible() ? "yes" : "no", '\n'
+    );
+}
+
 void GridWindow::set_description(const Glib::ustring& text) {
     this->description.set_text(text);
 }
@@ -359,6 +619,9 @@ void GridWindow::save_cache() {
 }
 
 void GridWindow::on_show() {
+    // the trace is usually started by the show request
+    show_trace.start();
+    Trace::Span span{ "show.on_show" };
     // when running in server mode, the window is not scrolled back to top
     // each time it's shown
     // so we'll do it on our own
@@ -366,6 +629,9 @@ void GridWindow::on_show() {
     auto vadjustment = scrolled_window.get_vadjustment();
     hadjustment->set_value(hadjustment->get_lower());
     vadjustment->set_value(vadjustment->get_lower());
+    if (grid_view) {
+        grid_view->scroll_to_top();
+    }
     focus_first_box();
     searchbox.set_text("");
     if(!config.command_show.empty()) {
@@ -375,6 +641,7 @@ void GridWindow::on_show() {
 }
 
 void GridWindow::on_hide() {
+    show_trace.stop();
     if(!config.command_hide.empty()) {
         system(config.command_hide.c_str());
     }
@@ -387,12 +654,26 @@ bool GridWindow::on_delete_event(GdkEventAny* event) {
     return CommonWindow::on_delete_event(event);
 }
 
+#ifdef NWG_TRACING
+bool GridWindow::on_map_event(GdkEventAny* event) {
+    show_trace.mark("show.map");
+    return PlatformWindow::on_map_event(event);
+}
+
+bool GridWindow::on_draw(const Cairo::RefPtr<Cairo::Context>& cr) {
+    auto result = PlatformWindow::on_draw(cr);
+    show_trace.mark("show.first-frame");
+    return result;
+}
+#endif
+
 void GridWindow::run_box(GridBox& box) {
+    Trace::Span span{ "run_box" };
     favs_changed = true;
     ++stats_of(box).clicks;
-    auto& cmd = exec_of(box);
-    // TODO: use special flag
-    if (cmd.find(config.term) == 0) {
+    auto terminal = box.entry->desktop_entry().terminal;
+    auto cmd = terminal ? concat(config.term, " ", exec_of(box)) : std::string{ exec_of(box) };
+    if (terminal) {
         Log::info("Running: \'", cmd, "\'");
     }
     try {
@@ -405,45 +686,56 @@ void GridWindow::run_box(GridBox& box) {
     hide();
 }
 
-inline auto with_box_by_id = [](auto && container, auto && desktop_id, auto && foo) {
-    auto cmp = [&desktop_id](auto && box) { return box.entry->desktop_id == desktop_id; };
-    if (auto iter = std::find_if(container.begin(), container.end(), cmp); iter != container.end()) {
-        foo(iter);
+void GridWindow::remove_box(GridBox& box) {
+    auto handle = boxes_by_slot[box.entry->slot];
+    // delete references to the widget from models
+    pinned_boxes->erase(box);
+    fav_boxes->erase(box);
+    apps_boxes->erase(box);
+    // remove flowboxchild
+    box.reference();
+    if (auto parent = dynamic_cast<Gtk::FlowBoxChild*>(box.get_parent())) {
+        if (auto flowbox = parent->get_parent()) {
+            flowbox->remove(*parent);
+        }
     }
-};
+    // delete the actual widget
+    all_boxes.erase(handle);
+}
 
-void GridWindow::remove_box_by_desktop_id(std::string_view desktop_id) {
-    with_box_by_id(all_boxes, desktop_id, [this](auto && iter) {
-        auto && box = *iter;
-        // delete references to the widget from models
-        pinned_boxes->erase(box);
-        fav_boxes->erase(box);
-        apps_boxes->erase(box);
-        // remove flowboxchild
-        box.reference();
-        if (auto parent = dynamic_cast<Gtk::FlowBoxChild*>(box.get_parent())) {
-            if (auto flowbox = parent->get_parent()) {
-                flowbox->remove(*parent);
-            }
-        }
-        // delete the actual widget
-        all_boxes.erase(iter);
-    });
+void GridWindow::update_box(GridBox& box, bool name_changed) {
+    // the common boxes are found by the name they are sorted by
+    auto old_name = box.name;
+    box.update_text();
+    // pinned & favourites are not sorted by name, the common boxes are sorted by name or ranked by the search key
+    if (name_changed || apps_boxes->is_filtered()) {
+        apps_boxes->reposition(box, old_name);
+    }
+    if (box.has_focus()) {
+        set_description(box.comment);
+    }
+    if (grid_view) {
+        grid_view->queue_draw();
+    }
 }
 
-void GridWindow::update_box_by_id(std::string_view desktop_id, GridBox && new_box) {
-    with_box_by_id(all_boxes, desktop_id, [this,&new_box](auto && iter) {
-        auto && box = *iter;
-        auto && new_box_ref = all_boxes.emplace_front(std::move(new_box));
-        pinned_boxes->update(box, new_box_ref);
-        fav_boxes->update(box, new_box_ref);
-        apps_boxes->update(box, new_box_ref);
-        all_boxes.erase(iter);
-    });
+GridBox::GridBox(Entry& entry)
+: entry{ &entry }
+{
+    this->set_always_show_image(true);
+    this->update_text();
+    this->set_image_position(Gtk::POS_TOP);
+}
+
+void GridBox::update_text() {
+    auto && desktop_entry = entry->desktop_entry();
+    name.assign(desktop_entry.name.begin(), desktop_entry.name.end());
+    comment.assign(desktop_entry.comment.begin(), desktop_entry.comment.end());
+    search_key = SearchKey{ name.raw(), desktop_entry.exec, desktop_entry.keywords, comment.raw() };
+    set_display_name_();
 }
 
-GridBox::GridBox(Glib::ustring name, Glib::ustring comment, Entry& entry)
-: name(std::move(name)), comment(std::move(comment)), entry{ &entry } {
+void GridBox::set_display_name_() {
     // As we sort dynamically by actual names, we need to avoid shortening them, or long names will remain unsorted.
     // See the issue: https://github.com/nwg-piotr/nwg-launchers/issues/128
     auto display_name = this->name;
@@ -451,9 +743,7 @@ GridBox::GridBox(Glib::ustring name, Glib::ustring comment, Entry& entry)
        display_name.resize(22);
        display_name += "...";
     }
-    this->set_always_show_image(true);
     this->set_label(display_name);
-    this->set_image_position(Gtk::POS_TOP);
 }
 
 bool GridBox::on_button_press_event(GdkEventButton* event) {
@@ -486,13 +776,122 @@ void GridBox::on_activate() {
 }
 
 void GridInstance::on_sighup() {
-    Log::error("let's assume we reload something");
+    if (!reload) {
+        Log::warn("Reloading is not supported");
+        return;
+    }
+    try {
+        reload({});
+    } catch (const std::exception& e) {
+        Log::error("Failed to reload: ", e.what());
+    }
 }
 
 void GridInstance::on_sigusr1() {
+    window.show_trace.start();
     window.show(hint::Fullscreen);
 }
 
+void GridInstance::on_command(SocketServer::Request& request) {
+    using namespace std::string_view_literals;
+    // the request is the command & its arguments, each terminated by '\0'
+    std::vector<std::string_view> args;
+    std::string_view message{ request.message };
+    while (!message.empty()) {
+        auto end = message.find('\0');
+        if (end == message.npos) {
+            break;
+        }
+        args.push_back(message.substr(0, end));
+        message.remove_prefix(end + 1);
+    }
+    auto reply = [&request](std::string_view text) {
+        try {
+            request.connection.send(text);
+        } catch (const std::exception& e) {
+            Log::error("Failed to reply to the client: ", e.what());
+        }
+    };
+    if (args.empty() || !message.empty()) {
+        reply("error: malformed request\n");
+        return;
+    }
+    auto command = args[0];
+    auto expect_args = [&](std::size_t n) {
+        if (args.size() != n + 1) {
+            reply(concat("error: '", command, "' takes ", std::to_string(n), " argument(s)\n"));
+            return false;
+        }
+        return true;
+    };
+    if (command == "show"sv) {
+        if (expect_args(0)) {
+            window.show_trace.start();
+            window.show(hint::Fullscreen);
+            reply("ok\n");
+        }
+    } else if (command == "hide"sv) {
+        if (expect_args(0)) {
+            window.hide();
+            reply("ok\n");
+        }
+    } else if (command == "toggle"sv) {
+        if (expect_args(0)) {
+            if (window.get_visible()) {
+                window.hide();
+            } else {
+                window.show_trace.start();
+                window.show(hint::Fullscreen);
+            }
+            reply("ok\n");
+        }
+    } else if (command == "reload"sv) {
+        // the arguments, if any, replace the server ones
+        if (!reload) {
+            reply("error: reloading is not supported\n");
+            return;
+        }
+        try {
+            reload(std::vector<std::string>(args.begin() + 1, args.end()));
+            reply("ok\n");
+        } catch (const std::exception& e) {
+            reply(concat("error: ", e.what(), '\n'));
+        }
+    } else if (command == "show-with-query"sv) {
+        if (expect_args(1)) {
+            window.show_trace.start();
+            window.show_with_query(Glib::ustring{ args[1].begin(), args[1].end() });
+            reply("ok\n");
+        }
+    } else if (command == "set-columns"sv) {
+        if (expect_args(1)) {
+            std::size_t num_col;
+            if (parse_number(args[1], num_col) && num_col > 0 && num_col < 100) {
+                window.set_columns(num_col);
+                reply("ok\n");
+            } else {
+                reply("error: columns must be in range 1 - 99\n");
+            }
+        }
+    } else if (command == "stats"sv) {
+        if (expect_args(0)) {
+            reply(window.stats());
+        }
+    } else if (command == "trace"sv) {
+        if (expect_args(0)) {
+            if (!Trace::enabled) {
+                reply("error: nwggrid-server is built without tracing\n");
+            } else if (auto report = Trace::report(); report.empty()) {
+                reply("no samples\n");
+            } else {
+                reply(report);
+            }
+        }
+    } else {
+        reply(concat("error: unknown command '", command, "'\n"));
+    }
+}
+
 void GridInstance::on_sigint() {
     app.release();
 }
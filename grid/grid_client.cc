@@ -8,22 +8,111 @@
  * */
 
 #include <fstream>
+#include <iostream>
 #include <string_view>
 #include <vector>
 
 #include "nwg_tools.h"
 #include "nwg_exceptions.h"
+#include "nwg_socket.h"
 #include "nwgconfig.h"
+#include "grid.h"
 
 const char* const HELP_MESSAGE = "\
 GTK application grid: nwggrid " VERSION_STR " (c) 2021 Piotr Miller, Sergey Smirnykh & Contributors \n\n\
 Usage:\n\
-    nwggrid -client      sends -SIGUSR1 to nwggrid-server, requires nwggrid-server running\n\
-    nwggrid [ARGS...]    launches nwggrid-server -oneshot ARGS...\n\n\
+    nwggrid -client [COMMAND]  sends COMMAND to nwggrid-server, requires nwggrid-server running\n\
+    nwggrid [ARGS...]          launches nwggrid-server -oneshot ARGS...\n\n\
+\
+Commands:\n\
+    show                    show the grid (default)\n\
+    hide                    hide the grid\n\
+    toggle                  show the grid if it is hidden, hide otherwise\n\
+    reload [ARGS...]        re-read the style & rescan the entries, ARGS replace the server options\n\
+    show-with-query <text>  show the grid searching for <text>\n\
+    set-columns <n>         set the number of grid columns (1 - 99)\n\
+    stats                   print the server statistics\n\
+    trace                   print the latency histograms (requires building with -Dtracing=true)\n\n\
+If the server does not listen on the control socket, only `show` & `reload` work, falling back to signals\n\n\
 \
 See also:\n\
     nwggrid-server -h\n";
 
+namespace {
+    // older servers only understand signals
+    int signal_server(std::string_view command) {
+        using namespace std::string_view_literals;
+        int sig;
+        if (command == "show"sv) {
+            sig = SIGUSR1;
+        } else if (command == "reload"sv) {
+            sig = SIGHUP;
+        } else {
+            throw std::runtime_error{ concat("nwggrid-server does not support '", command, "'") };
+        }
+        auto pid_file = get_pid_file("nwggrid-server.pid");
+        Log::info("Using pid file ", pid_file);
+        auto pid = get_instance_pid(pid_file.c_str());
+        if (!pid) {
+            throw std::runtime_error{ "nwggrid-server is not running" };
+        }
+        if (kill(*pid, sig) != 0) {
+            int err = errno;
+            throw ErrnoException{ "failed to signal nwggrid-server: ", err };
+        }
+        Log::plain("Success");
+        return EXIT_SUCCESS;
+    }
+
+    // sends the command & its arguments to nwggrid-server, prints the reply
+    int run_client(int argc, char* argv[]) {
+        using namespace std::string_view_literals;
+        std::string request;
+        if (argc == 0) {
+            request = "show"sv;
+            request += '\0';
+        }
+        for (int i = 0; i < argc; ++i) {
+            request += argv[i];
+            request += '\0';
+        }
+        std::string_view command{ request.c_str() };
+        SocketConnection connection;
+        try {
+            connection = connect_socket(get_socket_path());
+        } catch (const std::exception& e) {
+            Log::info("Failed to connect to the control socket: ", e.what());
+            if (argc > 1) {
+                throw std::runtime_error{ concat("nwggrid-server does not accept arguments for '", command, "'") };
+            }
+            return signal_server(command);
+        }
+        connection.send(request);
+        std::string reply;
+        std::vector<int> fds;
+        if (!connection.receive(reply, fds)) {
+            throw std::runtime_error{ "nwggrid-server closed the connection" };
+        }
+        for (auto fd: fds) {
+            close(fd);
+        }
+        std::string_view text{ reply };
+        if (!text.empty() && text.back() == '\n') {
+            text.remove_suffix(1);
+        }
+        if (text.compare(0, "error: "sv.size(), "error: "sv) == 0) {
+            Log::error(text.substr("error: "sv.size()));
+            return EXIT_FAILURE;
+        }
+        if (command == "stats"sv || command == "trace"sv) {
+            std::cout << reply;
+        } else {
+            Log::plain("Success");
+        }
+        return EXIT_SUCCESS;
+    }
+}
+
 int main(int argc, char* argv[]) {
     try {
         using namespace std::string_view_literals;
@@ -37,21 +126,8 @@ int main(int argc, char* argv[]) {
             }
 
             if (argv1 == "-client"sv) {
-                auto pid_file = get_pid_file("nwggrid-server.pid");
-                Log::info("Using pid file ", pid_file);
                 Log::info("Running in client mode");
-                if (argc != 2) {
-                    Log::warn("Arguments after '-client' must be passed to nwggrid-server");
-                }
-                auto pid = get_instance_pid(pid_file.c_str());
-                if (!pid) {
-                    throw std::runtime_error{ "nwggrid-server is not running" };
-                }
-                if (kill(*pid, SIGUSR1) != 0) {
-                    throw std::runtime_error{ "failed to send SIGUSR1 to the pid" };
-                }
-                Log::plain("Success");
-                return EXIT_SUCCESS;
+                return run_client(argc - 2, argv + 2);
             }
         }
         char path[] = INSTALL_PREFIX_STR "/bin/nwggrid-server";
@@ -5,200 +5,516 @@
  * Project: https://github.com/nwg-piotr/nwg-launchers
  * License: GPL3
  * */
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+#include "nwg_pool.h"
 #include "grid_entries.h"
 
-inline bool looks_like_desktop_file(const Glib::RefPtr<Gio::File>& file) {
-    fs::path path{ file->get_path() };
-    return path.extension() == ".desktop";
-}
-inline bool looks_like_desktop_file(const fs::directory_entry& entry) {
-    auto && path = entry.path();
-    return path.extension() == ".desktop";
-}
-inline bool can_be_loaded(const Glib::RefPtr<Gio::File>& file) {
-    auto file_type = file->query_file_type();
-    return file_type == Gio::FILE_TYPE_REGULAR;
-}
-inline bool can_be_loaded(const fs::directory_entry& entry) {
-    return entry.is_regular_file();
-}
-inline auto desktop_id(const Glib::RefPtr<Gio::File>& file, const Glib::RefPtr<Gio::File>& dir) {
-    return dir->get_relative_path(file);
-}
-inline auto desktop_id(const fs::path& file, const fs::path& dir) {
-    return file.lexically_relative(dir);
+namespace {
+    // .desktop files nested deeper are ignored, this also stops symlink loops
+    constexpr int MAX_SCAN_DEPTH = 8;
+    // bounds the startup time on unusual trees
+    constexpr std::size_t MAX_SCAN_DIRS = 4096;
+
+    inline bool looks_like_desktop_file(const Glib::RefPtr<Gio::File>& file) {
+        fs::path path{ file->get_path() };
+        return path.extension() == ".desktop";
+    }
+    inline bool looks_like_desktop_file(const fs::directory_entry& entry) {
+        auto && path = entry.path();
+        return path.extension() == ".desktop";
+    }
+    inline bool can_be_loaded(const Glib::RefPtr<Gio::File>& file) {
+        auto file_type = file->query_file_type();
+        return file_type == Gio::FILE_TYPE_REGULAR;
+    }
+    inline bool can_be_loaded(const fs::directory_entry& entry) {
+        std::error_code ec;
+        return entry.is_regular_file(ec);
+    }
+    // "kde4/foo.desktop" -> "kde4-foo.desktop"
+    inline std::string to_desktop_id(std::string relative_path) {
+        std::replace(relative_path.begin(), relative_path.end(), '/', '-');
+        return relative_path;
+    }
+    inline auto desktop_id(const Glib::RefPtr<Gio::File>& file, const Glib::RefPtr<Gio::File>& dir) {
+        return to_desktop_id(dir->get_relative_path(file));
+    }
+    inline auto desktop_id(const fs::path& file, const fs::path& dir) {
+        return to_desktop_id(file.lexically_relative(dir).native());
+    }
+    inline bool same_entry(const DesktopEntry& a, const DesktopEntry& b) {
+        auto fields = [](const DesktopEntry& e) {
+            return std::tie(
+                e.name, e.exec, e.icon, e.comment, e.mime_type, e.keywords, e.try_exec,
+                e.categories, e.only_show_in, e.not_show_in, e.startup_wm_class, e.actions, e.terminal
+            );
+        };
+        return fields(a) == fields(b);
+    }
+    inline int depth_of(const fs::path& dir, const fs::path& root) {
+        auto relative = dir.lexically_relative(root);
+        return std::distance(relative.begin(), relative.end());
+    }
+
+    struct ScanResult {
+        std::vector<fs::path> files; // .desktop files
+        std::vector<fs::path> dirs;  // the scanned dir & its subdirs
+    };
+
+    /* Lists .desktop files in each of `dirs` and their subdirs up to MAX_SCAN_DEPTH, `depth` is the depth of `dirs`.
+     * The trees are walked breadth-first, all dirs of the same depth are listed in parallel */
+    std::vector<ScanResult> scan_dirs(Span<fs::path> dirs, int depth) {
+        std::vector<ScanResult> results(dirs.size());
+        struct Item {
+            std::size_t           result; // index in `results`
+            fs::path              dir;
+            std::vector<fs::path> files;
+            std::vector<fs::path> subdirs;
+        };
+        std::vector<Item> level;
+        for (std::size_t i = 0; i < dirs.size(); ++i) {
+            level.push_back({ i, dirs[i], {}, {} });
+        }
+        auto && pool = ThreadPool::global();
+        std::size_t scanned = 0;
+        for (; !level.empty(); ++depth) {
+            pool.parallel_for(level.size(), [&level](std::size_t i) {
+                auto && item = level[i];
+                std::error_code ec;
+                fs::directory_iterator dir_iter{ item.dir, ec };
+                for (auto& entry: dir_iter) {
+                    if (looks_like_desktop_file(entry)) {
+                        if (can_be_loaded(entry)) {
+                            item.files.push_back(entry.path());
+                        }
+                    } else if (entry.is_directory(ec) && !ec) {
+                        item.subdirs.push_back(entry.path());
+                    }
+                    ec.clear();
+                }
+            });
+            scanned += level.size();
+            std::vector<Item> next;
+            for (auto && item: level) {
+                auto && result = results[item.result];
+                result.dirs.push_back(std::move(item.dir));
+                std::move(item.files.begin(), item.files.end(), std::back_inserter(result.files));
+                if (depth >= MAX_SCAN_DEPTH) {
+                    continue;
+                }
+                for (auto && subdir: item.subdirs) {
+                    if (scanned + next.size() >= MAX_SCAN_DIRS) {
+                        Log::warn("Too many application subdirs, '", subdir, "' is ignored");
+                        continue;
+                    }
+                    next.push_back({ item.result, std::move(subdir), {}, {} });
+                }
+            }
+            level = std::move(next);
+        }
+        return results;
+    }
 }
 
 EntriesManager::EntriesManager(Span<fs::path> dirs, EntriesModel& table, GridConfig& config):
-    table{ table }, config{ config }, desktop_entry_config{ config.lang, config.term }
+    table{ table },
+    config{ config },
+    desktop_entry_config{ config.lang },
+    index{ config.index_file, desktop_entry_config },
+    batch{ std::make_shared<Batch>() }
 {
-    // set monitors
-    monitors.reserve(dirs.size());
+    batch->dispatcher = &dispatcher;
+    dispatcher.connect(sigc::mem_fun(*this, &EntriesManager::on_batch_parsed_));
+    load_(dirs);
+    table.flush();
+    index.save();
+}
+
+void EntriesManager::reload(Span<fs::path> dirs) {
+    // the rescan picks up whatever the pending events were about
+    batch_timer.disconnect();
+    pending.clear();
+    {
+        std::unique_lock lock{ batch->mutex };
+        // the job uses `index` & `desktop_entry_config`
+        batch->cv.wait(lock, [this]() { return !batch->parsing; });
+        batch->files.clear();
+        batch->parsed = false;
+    }
+    desktop_entry_config = DesktopEntryConfig{ config.lang };
+    index.on_config_changed();
+
+    // the monitors are bound to the priority, they are kept only if the dirs are the same
+    auto same_dirs = roots.size() == dirs.size();
+    for (std::size_t i = 0; same_dirs && i < roots.size(); ++i) {
+        same_dirs = roots[i]->get_path() == dirs[i].native();
+    }
+    if (!same_dirs) {
+        for (auto && [path, monitor]: monitors) {
+            monitor->cancel();
+        }
+        monitors.clear();
+    }
+    roots.clear();
+
+    if (load_(dirs)) {
+        table.flush();
+    }
+    index.save();
+}
+
+bool EntriesManager::load_(Span<fs::path> dirs) {
     for (auto && dir: dirs) {
-        auto dir_index = monitors.size();
-        auto monitored_dir = Gio::File::create_for_path(dir);
-        auto && monitor = monitors.emplace_back(monitored_dir->monitor_directory());
-        // dir_index and monitored_dir are captured by value
-        // TODO: should I disconnect on exit to make sure there is no dangling reference to `this`?
-        monitor->signal_changed().connect([this,monitored_dir,dir_index](auto && file1, auto && file2, auto event) {
-            (void)file2; // silence warning
-            if (looks_like_desktop_file(file1)) {
-                auto && id = desktop_id(file1, monitored_dir);
-                switch (event) {
-                    // ignored in favor of CHANGES_DONE_HINT
-                    case Gio::FILE_MONITOR_EVENT_CHANGED: break;
-                    case Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
-                        if (can_be_loaded(file1)) {
-                            on_file_changed(id, file1, dir_index);
-                        }
-                        break;
-                    case Gio::FILE_MONITOR_EVENT_DELETED:
-                        on_file_deleted(id, dir_index);
-                        break;
-                        // ignore because CREATED is emitted when the file is created but not written to
-                        // copying/moving emit two signals: CREATED and then CHANGED
-                    case Gio::FILE_MONITOR_EVENT_CREATED:
-                        // TODO: it seems we can safely ignored but I guess we should doublecheck
-                    case Gio::FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED: break;
-                                          // TODO: should we set WATCH_MOVES?
-                                          // we don't set WATCH_MOVES so these three should not be emitted
-                    case Gio::FILE_MONITOR_EVENT_RENAMED:
-                    case Gio::FILE_MONITOR_EVENT_MOVED_IN:
-                    case Gio::FILE_MONITOR_EVENT_MOVED_OUT: Log::warn("WATCH_MOVES flag is set but not handled"); break;
-                                          // we don't set SEND_MOVED (deprecated)
-                    case Gio::FILE_MONITOR_EVENT_MOVED: Log::warn("SEND_MOVED flag is deprecated and thus shouldn't be used"); break;
-                                          // TODO: handle unmounting, e.g. for all files in directory when pre-unmounting erase their entries
-                    case Gio::FILE_MONITOR_EVENT_PRE_UNMOUNT:
-                    case Gio::FILE_MONITOR_EVENT_UNMOUNTED: Log::warn("Unmounting is not supported yet"); break;
-                                          // no default statement so we could see a compiler warning if new flag is added in the future
-                };
+        roots.push_back(Gio::File::create_for_path(dir));
+    }
+    // list all dirs in parallel; the index of the root dir is used as priority
+    auto scanned = scan_dirs(dirs, 0);
+    for (std::size_t dir_index = 0; dir_index < scanned.size(); ++dir_index) {
+        for (auto && dir: scanned[dir_index].dirs) {
+            watch_dir_(dir, dir_index);
+        }
+    }
+
+    // resolve overrides sequentially, in order of priority, so that only the winners are parsed
+    std::unordered_set<std::string> found;
+    std::vector<Parsed> files;
+    for (std::size_t dir_index = 0; dir_index < scanned.size(); ++dir_index) {
+        for (auto && path: scanned[dir_index].files) {
+            auto id = desktop_id(path, dirs[dir_index]);
+            if (found.insert(id).second) {
+                files.push_back({ static_cast<int>(dir_index), std::move(id), std::move(path) });
+            } else {
+                Log::info(".desktop file '", path, "' with id '", id, "' overridden, ignored");
             }
-        });
+        }
     }
-    // dir_index is used as priority
-    std::size_t dir_index{ 0 };
-    for (auto && dir: dirs) {
-        std::error_code ec;
-        // TODO: shouldn't it be recursive_directory_iterator?
-        fs::directory_iterator dir_iter{ dir, ec };
-        for (auto& entry : dir_iter) {
-            if (ec) {
-                Log::error(ec.message());
-                ec.clear();
-                continue;
+
+    // the ids that are gone, or may be overridden by a dir which is no longer listed
+    std::vector<std::pair<std::string, int>> gone;
+    for (DesktopIds::Slot slot = 0; slot < desktop_ids_info.size(); ++slot) {
+        if (auto && meta = desktop_ids_info[slot]; meta && !found.count(std::string{ table.ids[slot] })) {
+            gone.emplace_back(table.ids[slot], meta->priority);
+        }
+    }
+    bool changed = false;
+    for (auto && [id, priority]: gone) {
+        changed |= apply_deleted_(id, priority);
+    }
+    // the winners always win, even if their dir has moved down the list
+    for (auto && file: files) {
+        if (auto slot = find_id_(file.id); slot != DesktopIds::NONE) {
+            desktop_ids_info[slot]->priority = file.priority;
+        }
+    }
+
+    // parse on the pool & apply the whole batch, the grids are rebuilt just once
+    ThreadPool::global().parallel_for(files.size(), [this,&files](std::size_t i) {
+        parse_(files[i]);
+    });
+    for (auto && file: files) {
+        changed |= apply_changed_(file);
+    }
+    return changed;
+}
+
+void EntriesManager::watch_dir_(const fs::path& dir, int priority) {
+    auto && monitor = monitors[dir.native()];
+    if (monitor) {
+        return;
+    }
+    monitor = Gio::File::create_for_path(dir)->monitor_directory();
+    // TODO: should I disconnect on exit to make sure there is no dangling reference to `this`?
+    monitor->signal_changed().connect([this,priority](auto && file1, auto && file2, auto event) {
+        (void)file2; // silence warning
+        on_monitor_event_(file1, event, priority);
+    });
+}
+
+void EntriesManager::on_monitor_event_(const Glib::RefPtr<Gio::File>& file, Gio::FileMonitorEvent event, int priority) {
+    auto && root = roots[priority];
+    switch (event) {
+        // ignored in favor of CHANGES_DONE_HINT
+        case Gio::FILE_MONITOR_EVENT_CHANGED: break;
+        case Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+            if (looks_like_desktop_file(file) && can_be_loaded(file)) {
+                on_file_changed(desktop_id(file, root), file->get_path(), priority);
+            }
+            break;
+        case Gio::FILE_MONITOR_EVENT_DELETED:
+            // the root dirs stay watched, so they are picked up if they are created again
+            if (auto path = file->get_path(); monitors.count(path) && !file->equal(root)) {
+                on_dir_deleted_(path, priority);
+            } else if (looks_like_desktop_file(file)) {
+                on_file_deleted(desktop_id(file, root), priority);
             }
-            if (looks_like_desktop_file(entry) && can_be_loaded(entry)) {
-                auto && path = entry.path();
-                auto && id = desktop_id(path, dir);
-                try_load_entry_(id, path, dir_index);
+            break;
+        // files are ignored because CREATED is emitted when the file is created but not written to
+        // copying/moving emit two signals: CREATED and then CHANGED
+        // dirs may be moved in with their contents, so they are scanned right away
+        case Gio::FILE_MONITOR_EVENT_CREATED:
+            if (file->query_file_type() == Gio::FILE_TYPE_DIRECTORY) {
+                on_dir_created_(file->get_path(), priority);
             }
+            break;
+        case Gio::FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED: break;
+                              // TODO: should we set WATCH_MOVES?
+                              // we don't set WATCH_MOVES so these three should not be emitted
+        case Gio::FILE_MONITOR_EVENT_RENAMED:
+        case Gio::FILE_MONITOR_EVENT_MOVED_IN:
+        case Gio::FILE_MONITOR_EVENT_MOVED_OUT: Log::warn("WATCH_MOVES flag is set but not handled"); break;
+                              // we don't set SEND_MOVED (deprecated)
+        case Gio::FILE_MONITOR_EVENT_MOVED: Log::warn("SEND_MOVED flag is deprecated and thus shouldn't be used"); break;
+                              // TODO: handle unmounting, e.g. for all files in directory when pre-unmounting erase their entries
+        case Gio::FILE_MONITOR_EVENT_PRE_UNMOUNT:
+        case Gio::FILE_MONITOR_EVENT_UNMOUNTED: Log::warn("Unmounting is not supported yet"); break;
+                              // no default statement so we could see a compiler warning if new flag is added in the future
+    };
+}
+
+void EntriesManager::on_dir_created_(const fs::path& dir, int priority) {
+    fs::path root{ roots[priority]->get_path() };
+    auto depth = depth_of(dir, root);
+    if (depth > MAX_SCAN_DEPTH) {
+        return;
+    }
+    // watched before it's scanned, so the files written meanwhile are not missed
+    watch_dir_(dir, priority);
+    std::vector<fs::path> dirs{ dir };
+    auto scanned = scan_dirs(dirs, depth);
+    for (auto && subdir: scanned[0].dirs) {
+        watch_dir_(subdir, priority);
+    }
+    for (auto && path: scanned[0].files) {
+        on_file_changed(desktop_id(path, root), path, priority);
+    }
+}
+
+void EntriesManager::on_dir_deleted_(const std::string& dir, int priority) {
+    // unwatch the dir & its subdirs
+    auto in_dir = [&dir](std::string_view path) {
+        return path.size() >= dir.size()
+            && path.compare(0, dir.size(), dir) == 0
+            && (path.size() == dir.size() || path[dir.size()] == '/');
+    };
+    // the monitor may be the one emitting the event, so they are released later
+    std::vector<Glib::RefPtr<Gio::FileMonitor>> retired;
+    for (auto iter = monitors.begin(); iter != monitors.end();) {
+        if (in_dir(iter->first)) {
+            iter->second->cancel();
+            retired.push_back(std::move(iter->second));
+            iter = monitors.erase(iter);
+        } else {
+            ++iter;
         }
-        ++dir_index;
-    }
-}
-
-// tries to load & insert entry with `id` from `file`
-void EntriesManager::try_load_entry_(std::string id, const fs::path& file, int priority) {
-    // node with id
-    std::list<std::string> id_node;
-    // desktop_ids_store stores string_views.
-    // If we just insert id, there will be dangling reference when id is freed.
-    // To avoid this, we store id in the node and then take a view of it.
-    auto && id_ = id_node.emplace_front(std::move(id));
-
-    auto [iter, inserted] = desktop_ids_info.try_emplace(
-        id_,
-        EntriesModel::Index{},
-        Metadata::Hidden,
-        priority
-    );
-    if (inserted) {
-        // the entry was inserted, therefore we need to add the node to the store
-        // to keep the view valid
-        desktop_ids_store.splice(desktop_ids_store.begin(), id_node);
-        // load it
-        on_desktop_entry(file, desktop_entry_config, Overloaded {
-            [&,this,iter=iter](std::unique_ptr<DesktopEntry> && desktop_entry){
-                auto && meta = iter->second;
-                meta.state = Metadata::Ok;
-                meta.index = table.emplace_entry(
-                    id_,
-                    Stats{},
-                    std::move(desktop_entry)
-                );
-            },
-            [&](OnDesktopEntry::Error){ Log::error("Failed to load desktop file '", file, "'"); },
-                         [](OnDesktopEntry::Hidden){ }
-        });
-    } else {
-        Log::info(".desktop file '", file, "' with id '", id_, "' overridden, ignored");
     }
+    Glib::signal_idle().connect_once([retired=std::move(retired)]() { (void)retired; });
+    // the files might have been deleted without notice
+    // matched by path, as ids of the subdir files may collide with the ones of the files above, e.g. kde4-foo.desktop
+    std::vector<std::string> ids;
+    for (DesktopIds::Slot slot = 0; slot < desktop_ids_info.size(); ++slot) {
+        auto && meta = desktop_ids_info[slot];
+        if (meta && meta->priority == priority && in_dir(meta->path.native())) {
+            ids.emplace_back(table.ids[slot]);
+        }
+    }
+    for (auto && id: ids) {
+        on_file_deleted(std::move(id), priority);
+    }
+}
+
+EntriesManager::~EntriesManager() {
+    batch_timer.disconnect();
+    {
+        std::unique_lock lock{ batch->mutex };
+        batch->dispatcher = nullptr;
+        // the job uses `index`
+        batch->cv.wait(lock, [this]() { return !batch->parsing; });
+    }
+    // pick up entries changed while running
+    index.save();
+}
+
+DesktopIds::Slot EntriesManager::find_id_(std::string_view id) const {
+    // the id may be interned by the table only, e.g. if it is pinned
+    if (auto slot = table.ids.find(id); slot < desktop_ids_info.size() && desktop_ids_info[slot]) {
+        return slot;
+    }
+    return DesktopIds::NONE;
+}
+
+// registers `id` with `priority` unless it is already known
+auto EntriesManager::register_id_(std::string_view id, int priority) -> std::pair<DesktopIds::Slot, bool> {
+    if (auto slot = find_id_(id); slot != DesktopIds::NONE) {
+        return { slot, false };
+    }
+    // the reference is released when the id is unregistered, see apply_deleted_
+    auto slot = table.ids.acquire(id);
+    if (slot >= desktop_ids_info.size()) {
+        desktop_ids_info.resize(table.ids.capacity());
+    }
+    desktop_ids_info[slot].emplace(EntriesModel::Index{}, Metadata::Hidden, priority);
+    return { slot, true };
+}
+
+void EntriesManager::on_file_changed(std::string id, fs::path path, int priority) {
+    pending.insert_or_assign({ priority, std::move(id) }, std::move(path));
+    schedule_batch_();
 }
 
 void EntriesManager::on_file_deleted(std::string id, int priority) {
-    if (auto result = desktop_ids_info.find(id); result != desktop_ids_info.end()) {
-        if (result->second.priority < priority) {
+    pending.insert_or_assign({ priority, std::move(id) }, fs::path{});
+    schedule_batch_();
+}
+
+void EntriesManager::schedule_batch_() {
+    auto now = Clock::now();
+    if (batch_timer.connected()) {
+        if (now - pending_since >= BATCH_MAX_DELAY) {
+            // events keep coming, don't postpone the batch any further
             return;
         }
-        if (result->second.state == Metadata::Ok) {
-            table.erase_entry(result->second.index);
-        }
-        desktop_ids_info.erase(result);
-        auto iter = std::find(desktop_ids_store.begin(), desktop_ids_store.end(), id);
-        desktop_ids_store.erase(iter);
+        batch_timer.disconnect();
     } else {
+        pending_since = now;
+    }
+    batch_timer = Glib::signal_timeout().connect([this]() {
+        start_batch_();
+        return false;
+    }, BATCH_DELAY.count());
+}
+
+void EntriesManager::start_batch_() {
+    if (pending.empty()) {
+        return;
+    }
+    std::vector<Parsed> files;
+    {
+        std::lock_guard lock{ batch->mutex };
+        if (batch->parsing || batch->parsed) {
+            // the previous batch is not applied yet, `pending` is picked up once it is
+            return;
+        }
+        files.reserve(pending.size());
+        for (auto && [key, path]: pending) {
+            files.push_back({ key.first, key.second, std::move(path) });
+        }
+        pending.clear();
+        batch->files = std::move(files);
+        batch->parsing = true;
+    }
+    ThreadPool::global().submit([this,batch=batch]() {
+        for (auto && file: batch->files) {
+            if (!file.path.empty()) {
+                parse_(file);
+            }
+        }
+        std::lock_guard lock{ batch->mutex };
+        // the batch stays busy until on_batch_parsed_ takes the files
+        batch->parsing = false;
+        batch->parsed = true;
+        if (batch->dispatcher) {
+            batch->dispatcher->emit();
+        }
+        batch->cv.notify_all();
+    });
+}
+
+void EntriesManager::on_batch_parsed_() {
+    std::vector<Parsed> files;
+    {
+        std::lock_guard lock{ batch->mutex };
+        if (!batch->parsed) {
+            // reload discarded the batch
+            return;
+        }
+        files.swap(batch->files);
+        batch->parsed = false;
+    }
+    bool changed = false;
+    for (auto && file: files) {
+        if (file.path.empty()) {
+            changed |= apply_deleted_(file.id, file.priority);
+        } else {
+            changed |= apply_changed_(file);
+        }
+    }
+    if (changed) {
+        // the grids are rebuilt once per batch
+        table.flush();
+    }
+    // the events came while the batch was parsed
+    if (!pending.empty()) {
+        schedule_batch_();
+    }
+}
+
+void EntriesManager::parse_(Parsed& file) {
+    index.on_desktop_entry(file.path, Overloaded {
+        [&file](std::unique_ptr<DesktopEntry> && desktop_entry) {
+            file.state = Metadata::Ok;
+            file.entry = std::move(desktop_entry);
+        },
+        [&file](OnDesktopEntry::Hidden) { file.state = Metadata::Hidden; },
+        [&file](OnDesktopEntry::Error) { file.state = Metadata::Invalid; }
+    });
+}
+
+bool EntriesManager::apply_deleted_(const std::string& id, int priority) {
+    auto slot = find_id_(id);
+    if (slot == DesktopIds::NONE) {
         Log::error("on_file_deleted: no entry with id '", id, "'");
+        return false;
+    }
+    auto && meta = *desktop_ids_info[slot];
+    if (meta.priority < priority) {
+        return false;
+    }
+    auto was_shown = meta.state == Metadata::Ok;
+    if (was_shown) {
+        table.erase_entry_deferred(meta.index);
     }
+    desktop_ids_info[slot].reset();
+    table.ids.release(slot);
+    return was_shown;
 }
 
-void EntriesManager::on_file_changed(std::string id, const Glib::RefPtr<Gio::File>& file, int priority) {
-    auto && path = file->get_path();
-    if (auto result = desktop_ids_info.find(id); result != desktop_ids_info.end()) {
-        auto && meta = result->second;
-        if (meta.priority < priority) {
+bool EntriesManager::apply_changed_(Parsed& file) {
+    auto [slot, inserted] = register_id_(file.id, file.priority);
+    auto && meta = *desktop_ids_info[slot];
+    if (!inserted) {
+        if (meta.priority < file.priority) {
             // changed file is overridden, no need to do anything
-            return;
+            return false;
         }
-        meta.priority = priority;
-        on_desktop_entry(path, desktop_entry_config, Overloaded {
-            // successfully reloaded the new entry
-            [&meta=meta,this,&result](std::unique_ptr<DesktopEntry> && desktop_entry) {
-                if (meta.state == Metadata::Ok) {
-                    // entry was ok, now ok -> update contents
-                    table.update_entry(
-                        result->second.index,
-                        result->first,
-                        Stats{},
-                        std::move(desktop_entry)
-                    );
-                } else {
-                    // entry wasn't ok, but now ok -> add it to table it
-                    meta.index = table.emplace_entry(
-                        result->first,
-                        Stats{},
-                        std::move(desktop_entry)
-                    );
-                    meta.state = Metadata::Ok;
-                }
-            },
-            // reloaded entry is hidden
-            [&meta=meta,this](OnDesktopEntry::Hidden){
-                if (meta.state == Metadata::Ok) {
-                    table.erase_entry(meta.index);
-                }
-                meta.state = Metadata::Hidden;
-            },
-            // failed to reload entry
-            [&meta=meta,&path=path,this](OnDesktopEntry::Error){
-                Log::error("Failed to load desktop file'", path, "'");
-                if (meta.state == Metadata::Ok) {
-                    table.erase_entry(meta.index);
-                }
-                meta.state = Metadata::Invalid;
+        meta.priority = file.priority;
+    }
+    meta.path = file.path;
+    bool changed = false;
+    switch (file.state) {
+        case Metadata::Ok:
+            if (meta.state != Metadata::Ok) {
+                // entry wasn't ok, but now ok -> add it to table it
+                meta.index = table.emplace_entry_deferred(table.ids[slot], slot, Stats{}, std::move(*file.entry));
+                changed = true;
+            } else if (!same_entry(table.row(meta.index).desktop_entry(), *file.entry)) {
+                // entry was ok, now ok -> update contents unless they are the same, e.g. the file was touched
+                table.update_entry(meta.index, std::move(*file.entry));
+                changed = true;
             }
-        });
-    } else {
-        // there was not such entry, add it
-        try_load_entry_(std::move(id), path, priority);
+            break;
+        case Metadata::Invalid:
+            Log::error("Failed to load desktop file '", file.path, "'");
+            [[fallthrough]];
+        case Metadata::Hidden:
+            if (meta.state == Metadata::Ok) {
+                table.erase_entry_deferred(meta.index);
+                changed = true;
+            }
+            break;
     }
+    meta.state = file.state;
+    return changed;
 }
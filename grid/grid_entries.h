@@ -8,16 +8,24 @@
 
 #pragma once
 
-#include <list>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
 #include <vector>
 
 #include "nwg_classes.h"
 #include "filesystem-compat.h"
+#include "desktop_ids.h"
+#include "desktop_index.h"
 #include "on_desktop_entry.h"
+#include "slab.h"
 #include "grid.h"
 
 // Table containing entries
-// internally is a thin wrapper over list<entry>
+// internally is a thin wrapper over Slab<Entry>, rows are addressed by the slab handles
 struct EntriesModel {
     GridConfig& config;
     GridWindow& window;
@@ -28,78 +36,160 @@ struct EntriesModel {
     Span<std::string> pins;
     Span<CacheEntry>  favs;
 
-    // list because entries should not get invalidated when inserting/erasing
-    std::list<Entry> entries;
-    using Index = typename decltype(entries)::iterator;
+    // slab because entries should not get invalidated when inserting/erasing
+    Slab<Entry> entries;
+    using Index = typename decltype(entries)::Handle;
+
+    // interned desktop ids, shared with EntriesManager; the pinned & favourite ids are held for the lifetime
+    DesktopIds         ids;
+    // stats of the pinned & favourite ids by slot, the others are not pinned & have no clicks
+    std::vector<Stats> preset_stats;
+
+    // boxes showing the fallback icon, their icons are requested on `flush`
+    std::unordered_set<GridBox*> without_icons;
 
     EntriesModel(GridConfig& config, GridWindow& window, IconProvider& icons, Span<std::string> pins, Span<CacheEntry> favs):
         config{ config }, window{ window }, icons{ icons }, pins{ pins }, favs{ favs }
     {
-        // intentionally left blank
+        icons.signal_icons_loaded().connect(sigc::mem_fun(window, &GridWindow::on_icons_loaded));
+        preset_stats_();
     }
 
     template <typename ... Ts>
     Index emplace_entry(Ts && ... args) {
-        auto & entry = entries.emplace_front(std::forward<Ts>(args)...);
+        auto index = emplace_entry_deferred(std::forward<Ts>(args)...);
+        flush();
+        return index;
+    }
+    // same as emplace_entry, but does not rebuild the grids
+    // use it when loading entries in batches and call `flush` after the batch is loaded
+    template <typename ... Ts>
+    Index emplace_entry_deferred(Ts && ... args) {
+        auto index = entries.emplace(std::forward<Ts>(args)...);
+        auto & entry = row(index);
         set_entry_stats(entry);
-        auto && box = window.emplace_box(
-            entry.desktop_entry().name,
-            entry.desktop_entry().comment,
-            entry
-        );
+        auto && box = window.emplace_box(entry);
+        entry.box = &box;
         // boxing is necessary
         // for some reason the icons are not shown if the images are not boxed
-        auto image = Gtk::make_managed<Gtk::Image>(icons.load_icon(entry.desktop_entry().icon));
+        // the actual icon is loaded in background, see `flush`
+        auto image = Gtk::make_managed<Gtk::Image>(icons.fallback);
         box.set_image(*image);
         box.set_always_show_image(true);
-        window.build_grids();
+        without_icons.insert(&box);
 
-        return entries.begin();
+        return index;
     }
-    template <typename ... Ts>
-    void update_entry(Index index, Ts && ... args) {
-        // TODO: merge entries
-        *index = Entry{ std::forward<Ts>(args)... };
-        auto && entry = *index;
-        set_entry_stats(entry);
-        GridBox new_box {
-            entry.desktop_entry().name,
-            entry.desktop_entry().comment,
-            entry
-        };
-        // boxing is necessary
-        // for some reason the icons are not shown if the images are not boxed
-        auto image = Gtk::make_managed<Gtk::Image>(icons.load_icon(entry.desktop_entry().icon));
-        new_box.set_image(*image);
-        window.update_box_by_id(entry.desktop_id, std::move(new_box));
+    // rebuilds the grids after a batch of entries is loaded and requests their icons
+    void flush() {
+        window.build_grids();
+        request_icons_();
+    }
+    // shows the fallback icon in all boxes & requests their icons again, e.g. when the icon size has changed
+    void reload_icons() {
+        for (auto && entry: entries) {
+            if (auto* image = dynamic_cast<Gtk::Image*>(entry.box->get_image())) {
+                image->set(icons.fallback);
+            }
+            without_icons.insert(entry.box);
+        }
+        request_icons_();
+    }
+    // updates the entry & its box in place, keeping the stats: the texts only if they have changed,
+    // the icon only if Icon= has changed; the box moves in the grid only if its name has changed
+    void update_entry(Index index, DesktopEntry desktop_entry) {
+        auto && entry = row(index);
+        auto && old = entry.desktop_entry();
+        auto name_changed = old.name != desktop_entry.name;
+        auto text_changed = name_changed
+            || old.comment != desktop_entry.comment
+            || old.exec != desktop_entry.exec
+            || old.keywords != desktop_entry.keywords;
+        auto icon_changed = old.icon != desktop_entry.icon;
+        entry.desktop_entry_ = std::move(desktop_entry);
+        if (text_changed) {
+            window.update_box(*entry.box, name_changed);
+        }
+        // the boxes without icons get theirs on `flush`
+        if (icon_changed && !without_icons.count(entry.box)) {
+            if (auto* image = dynamic_cast<Gtk::Image*>(entry.box->get_image())) {
+                image->set(icons.fallback);
+            }
+            request_icon_(*entry.box);
+        }
     }
     void erase_entry(Index index) {
-        auto && entry = *index;
-        window.remove_box_by_desktop_id(entry.desktop_id);
-        entries.erase(index);
+        erase_entry_deferred(index);
         window.build_grids();
     }
+    // same as erase_entry, but does not rebuild the grids, call `flush` after the batch is erased
+    void erase_entry_deferred(Index index) {
+        auto && entry = row(index);
+        without_icons.erase(entry.box);
+        window.remove_box(*entry.box);
+        entries.erase(index);
+    }
     auto & row(Index index) {
-        return *index;
+        return *entries.get(index);
     }
 private:
-    void set_entry_stats(Entry& entry) {
-        if (auto result = std::find(pins.begin(), pins.end(), entry.desktop_id); result != pins.end()) {
-            entry.stats.pinned = Stats::Pinned;
-            // temporary fix for #176
-            // see comments to PinnedBoxes class
-            entry.stats.position = (result - pins.begin()) - pins.size() - 1;
+    void request_icons_() {
+        // displayed boxes go first, so the visible icons are loaded first
+        window.for_each_displayed_box([this](auto && box) {
+            if (without_icons.erase(&box)) {
+                request_icon_(box);
+            }
+        });
+        // the rest are filtered out
+        for (auto* box: without_icons) {
+            request_icon_(*box);
+        }
+        without_icons.clear();
+    }
+    void request_icon_(GridBox& box) {
+        if (auto* image = dynamic_cast<Gtk::Image*>(box.get_image())) {
+            icons.load_icon_async(std::string{ box.entry->desktop_entry().icon }, *image);
+        }
+    }
+    void preset_stats_() {
+        auto stats_of = [this](auto && id) -> Stats& {
+            auto slot = ids.acquire(id);
+            if (slot >= preset_stats.size()) {
+                preset_stats.resize(ids.capacity());
+            }
+            return preset_stats[slot];
+        };
+        // the first occurrence wins
+        for (std::size_t i = 0; i < pins.size(); ++i) {
+            if (auto && stats = stats_of(pins[i]); !stats.pinned) {
+                stats.pinned = Stats::Pinned;
+                // temporary fix for #176
+                // see comments to PinnedBoxes class
+                stats.position = static_cast<int>(i) - static_cast<int>(pins.size()) - 1;
+            }
+        }
+        for (auto && fav: favs) {
+            if (auto && stats = stats_of(fav.desktop_id); !stats.favorite) {
+                stats.favorite = Stats::Favorite;
+                stats.clicks = fav.clicks;
+            }
         }
-        auto cmp = [&entry](auto && fav){ return entry.desktop_id == fav.desktop_id; };
-        if (auto result = std::find_if(favs.begin(), favs.end(), cmp); result != favs.end()) {
-            entry.stats.favorite = Stats::Favorite;
-            entry.stats.clicks = result->clicks;
+    }
+    void set_entry_stats(Entry& entry) {
+        if (entry.slot < preset_stats.size()) {
+            entry.stats = preset_stats[entry.slot];
         }
     }
 };
 
 /* EntriesManager handles loading/updating entries.
- * For each directory in `dirs` it sets a monitor and loads all .desktop files in it.
+ * For each directory in `dirs` it loads all .desktop files in it & its subdirs, setting a monitor on each of them;
+ * subdirs are watched & unwatched as they appear & disappear.
+ * `reload` rescans the dirs & diffs the result against the loaded entries:
+ * only the entries whose file contents or parsed fields have changed are updated, the rest keep their boxes & icons.
+ * File events are coalesced: the latest event of each file is kept until no events come for BATCH_DELAY,
+ * then the batch is parsed on the thread pool and applied to the table at once, rebuilding the grids once.
+ * The desktop id of a file is its path relative to the directory with '/' replaced by '-'.
  * It also supports "overwriting" files: if two files have the same desktop id,
  * it will work with the file stored in the directory listed first, i.e. having more precedence.
  * The "desktop id" mechanism it uses is a bit different than the mechanism described in
@@ -117,6 +207,7 @@ struct EntriesManager {
         FileState state;
         int       priority; // the lower the value, the bigger the priority
                             // i.e. if file1.priority > file2.priority, the file2 wins
+        fs::path  path;     // of the winning file, empty until it is applied
 
         Metadata(Index index, FileState state, int priority):
             index{ index }, state{ state }, priority{ priority }
@@ -125,24 +216,80 @@ struct EntriesManager {
         }
     };
 
-    // stores "desktop id"s
-    // list because insertions/removals should not invalidate the store
-    std::list<std::string>                         desktop_ids_store;
-    // maps "desktop id" to Metadata
-    std::unordered_map<std::string_view, Metadata> desktop_ids_info;
-    // stored monitors
-    // just to keep them alive
-    std::vector<Glib::RefPtr<Gio::FileMonitor>>    monitors;
+    // Metadata by the slot of "desktop id" in table.ids, empty if the id is not registered
+    std::vector<std::optional<Metadata>>           desktop_ids_info;
+    // application dirs, the index is the priority
+    std::vector<Glib::RefPtr<Gio::File>>           roots;
+    // monitors of the application dirs & their subdirs, by path
+    std::unordered_map<std::string, Glib::RefPtr<Gio::FileMonitor>> monitors;
 
     EntriesModel& table;
     GridConfig&   config;
 
     DesktopEntryConfig desktop_entry_config;
+    // parsed .desktop files from the previous runs
+    DesktopIndex       index;
+
+    using Clock = std::chrono::steady_clock;
+    // the batch is processed once there are no new events for BATCH_DELAY...
+    static constexpr std::chrono::milliseconds BATCH_DELAY{ 100 };
+    // ...but no later than BATCH_MAX_DELAY after its first event
+    static constexpr std::chrono::milliseconds BATCH_MAX_DELAY{ 1000 };
 
     EntriesManager(Span<fs::path> dirs, EntriesModel& table, GridConfig& config);
-    void on_file_changed(std::string id, const Glib::RefPtr<Gio::File>& file, int priority);
+    ~EntriesManager();
+    // rescans `dirs` with the current config.lang, pending events are dropped
+    void reload(Span<fs::path> dirs);
+    // queue the file event for the next batch
+    void on_file_changed(std::string id, fs::path path, int priority);
     void on_file_deleted(std::string id, int priority);
 private:
-    // tries to load & insert entry with `id` from `file`
-    void try_load_entry_(std::string id, const fs::path& file, int priority);
+    // file of the batch
+    struct Parsed {
+        int                           priority;
+        std::string                   id;
+        fs::path                      path;  // empty if the file was deleted
+        Metadata::FileState           state{ Metadata::Invalid };
+        std::unique_ptr<DesktopEntry> entry; // non-null if the state is Ok
+    };
+    // shared with the job parsing the batch
+    struct Batch {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        Glib::Dispatcher*       dispatcher; // null when EntriesManager is gone
+        bool                    parsing{ false }; // the job is running
+        bool                    parsed{ false };  // the job is done, `files` are to be applied
+        std::vector<Parsed>     files;            // owned by the job while it's parsing
+    };
+    // the latest event of each file: the file path or empty path if the file was deleted, by priority & id
+    std::map<std::pair<int, std::string>, fs::path> pending;
+    Clock::time_point                               pending_since;
+    sigc::connection                                batch_timer;
+    Glib::Dispatcher                                dispatcher;
+    std::shared_ptr<Batch>                          batch;
+
+    // scans & watches `dirs`, then loads the winners & unloads the ids not found; returns whether the table changed
+    bool load_(Span<fs::path> dirs);
+    // the slot of `id` if it is registered, NONE otherwise
+    DesktopIds::Slot find_id_(std::string_view id) const;
+    // registers `id` with `priority` unless it is already known, returns its slot & whether it was registered now
+    std::pair<DesktopIds::Slot, bool> register_id_(std::string_view id, int priority);
+    // parses file.path to `file`, thread-safe
+    void parse_(Parsed& file);
+    // (re)starts the timer processing the pending events
+    void schedule_batch_();
+    // parses the pending events on the thread pool
+    void start_batch_();
+    // applies the parsed batch to the table
+    void on_batch_parsed_();
+    // both return whether the table changed
+    bool apply_changed_(Parsed& file);
+    bool apply_deleted_(const std::string& id, int priority);
+    // sets a monitor on `dir` belonging to roots[priority]
+    void watch_dir_(const fs::path& dir, int priority);
+    void on_monitor_event_(const Glib::RefPtr<Gio::File>& file, Gio::FileMonitorEvent event, int priority);
+    // loads the .desktop files of the new subdir & watches it
+    void on_dir_created_(const fs::path& dir, int priority);
+    // unwatches the subdir & unloads its .desktop files
+    void on_dir_deleted_(const std::string& dir, int priority);
 };
@@ -0,0 +1,189 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <glib.h>
+
+#include <algorithm>
+
+#include "grid_search.h"
+
+namespace {
+    constexpr int SCORE_MATCH = 16;
+    constexpr int SCORE_GAP_START = -3;
+    constexpr int SCORE_GAP_EXTENSION = -1;
+    constexpr int BONUS_BOUNDARY = 8;   // match right after a non-word char
+    constexpr int BONUS_START = 10;     // match at the start of the field
+    constexpr int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+    constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+    // field scores are multiplied by FIELD_WEIGHT / 4, so the name matches rank first
+    constexpr std::array<int, SearchKey::Count> FIELD_WEIGHT { 4, 3, 3, 2 };
+
+    // length of utf-8 sequence starting with `c`
+    inline std::size_t utf8_length(unsigned char c) {
+        return c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+    }
+
+    inline bool is_word(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+    }
+
+    inline int bonus_at(std::string_view field, std::size_t pos) {
+        if (pos == 0) {
+            return BONUS_START;
+        }
+        return is_word(field[pos - 1]) ? 0 : BONUS_BOUNDARY;
+    }
+
+    // utf-8 sequence of `str` starting at `pos`
+    inline std::string_view char_at(std::string_view str, std::size_t pos) {
+        return str.substr(pos, utf8_length(str[pos]));
+    }
+
+    int score_field(std::string_view query, std::string_view field) {
+        // find the first end of the query as a subsequence of the field...
+        std::size_t end = 0;
+        for (std::size_t q = 0; q < query.size();) {
+            auto c = char_at(query, q);
+            auto found = field.find(c, end);
+            if (found == field.npos) {
+                return NO_MATCH;
+            }
+            end = found + c.size();
+            q += c.size();
+        }
+        // ...then walk back to find the shortest match ending there
+        auto start = end;
+        for (auto q = query.size(); q > 0;) {
+            auto prev = q - 1;
+            while (prev > 0 && (static_cast<unsigned char>(query[prev]) & 0xC0) == 0x80) {
+                --prev;
+            }
+            auto c = query.substr(prev, q - prev);
+            start = field.rfind(c, start - c.size());
+            q = prev;
+        }
+        // and score it
+        int score = 0;
+        int consecutive = 0;
+        int first_bonus = 0;
+        bool in_gap = false;
+        std::size_t q = 0;
+        for (auto pos = start; pos < end;) {
+            auto c = char_at(field, pos);
+            if (q < query.size() && c == char_at(query, q)) {
+                auto bonus = bonus_at(field, pos);
+                if (consecutive == 0) {
+                    first_bonus = bonus;
+                } else {
+                    // the bonus of the chunk's first char is shared by the whole chunk
+                    if (bonus >= BONUS_BOUNDARY) {
+                        first_bonus = bonus;
+                    }
+                    bonus = std::max({ bonus, first_bonus, BONUS_CONSECUTIVE });
+                }
+                score += SCORE_MATCH + (q == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus);
+                ++consecutive;
+                in_gap = false;
+                q += c.size();
+            } else {
+                score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+                consecutive = 0;
+                in_gap = true;
+            }
+            pos += c.size();
+        }
+        return score;
+    }
+
+    std::string casefold(std::string_view str) {
+        auto* folded = g_utf8_casefold(str.data(), str.size());
+        std::string result{ folded };
+        g_free(folded);
+        return result;
+    }
+
+    // "env A=1 /usr/bin/foo --bar" -> "foo"
+    std::string_view command_name(std::string_view exec) {
+        std::size_t pos = 0;
+        while (pos < exec.size()) {
+            auto begin = exec.find_first_not_of(' ', pos);
+            if (begin == exec.npos) {
+                break;
+            }
+            auto end = std::min(exec.find(' ', begin), exec.size());
+            auto word = exec.substr(begin, end - begin);
+            pos = end;
+            if (word == "env" || word.find('=') != word.npos) {
+                continue;
+            }
+            if (auto slash = word.rfind('/'); slash != word.npos) {
+                word.remove_prefix(slash + 1);
+            }
+            return word;
+        }
+        return {};
+    }
+}
+
+std::uint64_t byte_mask(std::string_view str) {
+    std::uint64_t mask = 0;
+    for (unsigned char c: str) {
+        mask |= std::uint64_t{ 1 } << (c & 63);
+    }
+    return mask;
+}
+
+SearchKey::SearchKey(std::string_view name, std::string_view exec, std::string_view keywords, std::string_view comment) {
+    std::array<std::string_view, Count> fields { name, command_name(exec), keywords, comment };
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        if (i > 0) {
+            text += '\n';
+        }
+        text += casefold(fields[i]);
+        ends[i] = text.size();
+    }
+    mask = byte_mask(text);
+}
+
+SearchQuery::SearchQuery(std::string_view query):
+    text{ casefold(query) },
+    mask{ byte_mask(text) }
+{
+    // intentionally left blank
+}
+
+bool SearchQuery::is_subsequence_of(const SearchQuery& other) const {
+    std::size_t pos = 0;
+    for (std::size_t q = 0; q < text.size();) {
+        auto c = char_at(text, q);
+        auto found = std::string_view{ other.text }.find(c, pos);
+        if (found == std::string_view::npos) {
+            return false;
+        }
+        pos = found + c.size();
+        q += c.size();
+    }
+    return true;
+}
+
+int fuzzy_score(const SearchQuery& query, const SearchKey& key) {
+    if (query.empty()) {
+        return 0;
+    }
+    if ((key.mask & query.mask) != query.mask) {
+        return NO_MATCH;
+    }
+    auto best = NO_MATCH;
+    for (std::uint8_t f = 0; f < SearchKey::Count; ++f) {
+        auto field = static_cast<SearchKey::Field>(f);
+        if (auto score = score_field(query.text, key.field(field)); score != NO_MATCH) {
+            best = std::max(best, score * FIELD_WEIGHT[f] / 4);
+        }
+    }
+    return best;
+}
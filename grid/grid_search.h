@@ -0,0 +1,67 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+/*
+ * Fuzzy matching used by the grid search.
+ * The query matches a field if it is a subsequence of it, the match is scored fzf-style:
+ * matched chars score points, gaps cost points, matches at word boundaries, at the start
+ * of the field and consecutive matches get bonuses. Fields are scored separately, the best one wins.
+ * Both the query and the fields are casefolded utf-8, matching is done on whole utf-8 sequences.
+ */
+
+// returned by fuzzy_score if the query does not match
+constexpr int NO_MATCH = std::numeric_limits<int>::min();
+
+/* Searchable fields of an entry, casefolded once when the entry is loaded.
+ * Each GridBox owns its key, so the keys are not laid out in one array; scoring a candidate first checks
+ * `mask` against the query, which rejects most of them without touching `text`, and allocates nothing */
+struct SearchKey {
+    enum Field: std::uint8_t {
+        Name = 0,
+        Exec,     // basename of the command
+        Keywords,
+        Comment,
+        Count
+    };
+    std::string                      text; // fields separated by '\n'
+    std::array<std::uint32_t, Count> ends; // end offset of each field in `text`
+    std::uint64_t                    mask; // see byte_mask
+
+    SearchKey() = default;
+    SearchKey(std::string_view name, std::string_view exec, std::string_view keywords, std::string_view comment);
+
+    std::string_view field(Field f) const {
+        std::uint32_t begin = f == Name ? 0 : ends[f - 1] + 1;
+        return std::string_view{ text }.substr(begin, ends[f] - begin);
+    }
+};
+
+struct SearchQuery {
+    std::string   text; // casefolded
+    std::uint64_t mask;
+
+    explicit SearchQuery(std::string_view query);
+    bool empty() const { return text.empty(); }
+    // whether `this` is a subsequence of `other`, so everything `other` matches `this` matches too
+    bool is_subsequence_of(const SearchQuery& other) const;
+};
+
+// Set of bytes present in `str`, hashed to 64 bits; the key can't match the query
+// unless its mask has all the bits of the query mask
+std::uint64_t byte_mask(std::string_view str);
+
+// returns the score of the best matching field of `key` or NO_MATCH, does not allocate
+int fuzzy_score(const SearchQuery& query, const SearchKey& key);
@@ -101,3 +101,7 @@ std::vector<CacheEntry> get_favourites(ns::json&& cache, int number) {
     sorted_cache.erase(from, to);
     return sorted_cache;
 }
+
+fs::path get_socket_path() {
+    return get_runtime_dir() / "nwggrid-server.sock";
+}
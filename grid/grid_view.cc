@@ -0,0 +1,472 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <algorithm>
+#include <cmath>
+
+#include "grid_view.h"
+
+namespace {
+    // the same as the FlowBox spacing & the default button padding + margin
+    constexpr int SPACING = 5;
+    constexpr int CELL_PADDING = 10;
+    constexpr int LABEL_GAP = 4;
+    // the labels are ellipsized to this many average chars
+    constexpr int LABEL_CHARS = 16;
+    // between the sections, the separator is drawn in the middle
+    constexpr int SECTION_GAP = 30;
+}
+
+GridView::GridView(GridWindow& window, BoxesModel& pinned, BoxesModel& favs, BoxesModel& apps):
+    window{ window },
+    sections{ { &pinned, &favs, &apps } },
+    vadjustment{ Gtk::Adjustment::create(0, 0, 0) }
+{
+    set_name("gridview");
+    set_can_focus(true);
+    add_events(
+        Gdk::POINTER_MOTION_MASK | Gdk::LEAVE_NOTIFY_MASK | Gdk::BUTTON_PRESS_MASK |
+        Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK | Gdk::KEY_PRESS_MASK | Gdk::FOCUS_CHANGE_MASK
+    );
+    for (auto* section: sections) {
+        // a search emits a change per changed range, the view is laid out once after all of them
+        section->signal_items_changed().connect([this](guint, guint, guint) { queue_relayout_(); });
+    }
+    vadjustment->signal_value_changed().connect([this]() { queue_draw(); });
+    update_metrics_();
+    refresh();
+}
+
+GridView::~GridView() {
+    relayout_idle.disconnect();
+}
+
+void GridView::update_metrics_() {
+    auto context = get_pango_context();
+    auto metrics = context->get_metrics(context->get_font_description());
+    char_width = metrics.get_approximate_char_width() / PANGO_SCALE;
+    label_height = (metrics.get_ascent() + metrics.get_descent()) / PANGO_SCALE;
+    label = create_pango_layout("");
+    label->set_ellipsize(Pango::ELLIPSIZE_END);
+    label->set_alignment(Pango::ALIGN_CENTER);
+}
+
+void GridView::refresh() {
+    icon_size = window.config.icon_size;
+    cell_width = std::max(icon_size, LABEL_CHARS * char_width) + 2 * CELL_PADDING;
+    cell_height = icon_size + LABEL_GAP + label_height + 2 * CELL_PADDING;
+    label->set_width((cell_width - 2 * CELL_PADDING) * PANGO_SCALE);
+    relayout_();
+    queue_resize();
+}
+
+void GridView::icons_changed() {
+    if (icon_size != window.config.icon_size) {
+        refresh();
+    } else {
+        queue_draw();
+    }
+}
+
+void GridView::queue_relayout_() {
+    if (!relayout_idle.connected()) {
+        // before the resize & the redraw
+        relayout_idle = Glib::signal_idle().connect([this]() {
+            relayout_();
+            return false;
+        }, Glib::PRIORITY_HIGH_IDLE);
+    }
+}
+
+void GridView::ensure_layout_() {
+    if (relayout_idle.connected()) {
+        relayout_();
+    }
+}
+
+void GridView::relayout_() {
+    relayout_idle.disconnect();
+    auto width = get_allocated_width();
+    auto num_col = std::max<std::size_t>(window.config.num_col, 1);
+    int y = 0;
+    bool first = true;
+    for (std::size_t i = 0; i < sections.size(); ++i) {
+        auto && layout = layouts[i];
+        auto size = sections[i]->size();
+        if (size == 0) {
+            layout = Layout{ 0, y, 0, 0 };
+            continue;
+        }
+        if (!first) {
+            y += SECTION_GAP;
+        }
+        first = false;
+        layout.cols = std::min(size, num_col);
+        layout.rows = (size + layout.cols - 1) / layout.cols;
+        auto row_width = static_cast<int>(layout.cols) * (cell_width + SPACING) - SPACING;
+        layout.x = std::max(0, (width - row_width) / 2);
+        layout.y = y;
+        y += static_cast<int>(layout.rows) * (cell_height + SPACING) - SPACING;
+    }
+    content_height = y;
+
+    // the boxes may have moved or be gone
+    hovered = nullptr;
+    if (selected && (selected_cell.index >= sections[selected_cell.section]->size() || box_at_(selected_cell) != selected)) {
+        auto found = false;
+        for (std::size_t s = 0; s < sections.size() && !found; ++s) {
+            for (std::size_t i = 0; i < sections[s]->size(); ++i) {
+                if (box_at_({ s, i }) == selected) {
+                    selected_cell = { s, i };
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            selected = nullptr;
+        }
+    }
+    update_adjustment_();
+    queue_draw();
+}
+
+void GridView::update_adjustment_() {
+    auto page = std::max(get_allocated_height(), 1);
+    auto value = std::min(vadjustment->get_value(), static_cast<double>(std::max(content_height - page, 0)));
+    vadjustment->configure(value, 0, std::max(content_height, page), cell_height + SPACING, page * 0.9, page);
+}
+
+GridBox* GridView::box_at_(Cell cell) const {
+    return *(sections[cell.section]->begin() + cell.index);
+}
+
+bool GridView::cell_at_(double x, double y, Cell& cell) const {
+    auto content_y = static_cast<int>(y + vadjustment->get_value());
+    auto ix = static_cast<int>(x);
+    for (std::size_t s = 0; s < sections.size(); ++s) {
+        auto && layout = layouts[s];
+        if (layout.rows == 0 || content_y < layout.y) {
+            continue;
+        }
+        auto dy = content_y - layout.y;
+        auto row = static_cast<std::size_t>(dy / (cell_height + SPACING));
+        if (row >= layout.rows) {
+            continue;
+        }
+        auto dx = ix - layout.x;
+        if (dx < 0 || dy % (cell_height + SPACING) >= cell_height || dx % (cell_width + SPACING) >= cell_width) {
+            return false;
+        }
+        auto col = static_cast<std::size_t>(dx / (cell_width + SPACING));
+        auto index = row * layout.cols + col;
+        if (col >= layout.cols || index >= sections[s]->size()) {
+            return false;
+        }
+        cell = { s, index };
+        return true;
+    }
+    return false;
+}
+
+void GridView::cell_origin_(Cell cell, int& x, int& y) const {
+    auto && layout = layouts[cell.section];
+    x = layout.x + static_cast<int>(cell.index % layout.cols) * (cell_width + SPACING);
+    y = layout.y + static_cast<int>(cell.index / layout.cols) * (cell_height + SPACING);
+}
+
+void GridView::get_preferred_width_vfunc(int& minimum, int& natural) const {
+    auto num_col = static_cast<int>(std::max<std::size_t>(window.config.num_col, 1));
+    minimum = cell_width;
+    natural = num_col * (cell_width + SPACING) - SPACING;
+}
+
+void GridView::get_preferred_height_vfunc(int& minimum, int& natural) const {
+    // the view scrolls itself, it takes whatever is left
+    minimum = cell_height;
+    natural = cell_height;
+}
+
+void GridView::on_size_allocate(Gtk::Allocation& allocation) {
+    Gtk::DrawingArea::on_size_allocate(allocation);
+    relayout_();
+}
+
+void GridView::on_style_updated() {
+    Gtk::DrawingArea::on_style_updated();
+    update_metrics_();
+    refresh();
+}
+
+bool GridView::on_draw(const Cairo::RefPtr<Cairo::Context>& cr) {
+    ensure_layout_();
+    auto style = get_style_context();
+    auto offset = static_cast<int>(vadjustment->get_value());
+    double x1, y1, x2, y2;
+    cr->get_clip_extents(x1, y1, x2, y2);
+    auto top = offset + static_cast<int>(std::floor(y1));
+    auto bottom = offset + static_cast<int>(std::ceil(y2));
+    auto row_height = cell_height + SPACING;
+    auto focused = has_focus();
+
+    auto num_col = static_cast<int>(std::max<std::size_t>(window.config.num_col, 1));
+    auto grid_width = std::min(get_allocated_width(), num_col * (cell_width + SPACING) - SPACING);
+    bool first = true;
+    for (std::size_t s = 0; s < sections.size(); ++s) {
+        auto && layout = layouts[s];
+        if (layout.rows == 0) {
+            continue;
+        }
+        if (!first) {
+            auto y = layout.y - SECTION_GAP / 2 - offset;
+            auto color = style->get_color(get_state_flags());
+            color.set_alpha(color.get_alpha() * 0.5);
+            Gdk::Cairo::set_source_rgba(cr, color);
+            cr->rectangle((get_allocated_width() - grid_width) / 2, y, grid_width, 1);
+            cr->fill();
+        }
+        first = false;
+        auto section_bottom = layout.y + static_cast<int>(layout.rows) * row_height;
+        if (section_bottom <= top || layout.y >= bottom) {
+            continue;
+        }
+        // only the rows intersecting the clip are painted
+        auto first_row = static_cast<std::size_t>(std::max(top - layout.y, 0) / row_height);
+        auto last_row = std::min(layout.rows, static_cast<std::size_t>((bottom - layout.y) / row_height) + 1);
+        auto size = sections[s]->size();
+        for (auto index = first_row * layout.cols; index < std::min(size, last_row * layout.cols); ++index) {
+            auto* box = box_at_({ s, index });
+            int x, y;
+            cell_origin_({ s, index }, x, y);
+            y -= offset;
+
+            auto state = Gtk::STATE_FLAG_NORMAL;
+            if (box == hovered) {
+                state |= Gtk::STATE_FLAG_PRELIGHT;
+            }
+            if (box == selected && focused) {
+                state |= Gtk::STATE_FLAG_FOCUSED;
+            }
+            style->context_save();
+            style->add_class("cell");
+            style->set_state(state);
+            style->render_background(cr, x, y, cell_width, cell_height);
+            style->render_frame(cr, x, y, cell_width, cell_height);
+            if (box == selected && focused) {
+                style->render_focus(cr, x, y, cell_width, cell_height);
+            }
+            auto color = style->get_color(state);
+            style->context_restore();
+
+            if (auto* image = dynamic_cast<Gtk::Image*>(box->get_image())) {
+                if (auto pixbuf = image->get_pixbuf()) {
+                    auto px = x + (cell_width - pixbuf->get_width()) / 2;
+                    auto py = y + CELL_PADDING + (icon_size - pixbuf->get_height()) / 2;
+                    Gdk::Cairo::set_source_pixbuf(cr, pixbuf, px, py);
+                    cr->rectangle(px, py, pixbuf->get_width(), pixbuf->get_height());
+                    cr->fill();
+                }
+            }
+            label->set_text(box->name);
+            Gdk::Cairo::set_source_rgba(cr, color);
+            cr->move_to(x + CELL_PADDING, y + CELL_PADDING + icon_size + LABEL_GAP);
+            label->show_in_cairo_context(cr);
+        }
+    }
+    return true;
+}
+
+bool GridView::on_motion_notify_event(GdkEventMotion* event) {
+    ensure_layout_();
+    Cell cell;
+    auto* box = cell_at_(event->x, event->y, cell) ? box_at_(cell) : nullptr;
+    if (box != hovered) {
+        hovered = box;
+        if (box) {
+            window.set_description(box->comment);
+        }
+        queue_draw();
+    }
+    return true;
+}
+
+bool GridView::on_leave_notify_event(GdkEventCrossing* event) {
+    (void)event; // suppress warning
+    if (hovered) {
+        hovered = nullptr;
+        queue_draw();
+    }
+    return false;
+}
+
+bool GridView::on_button_press_event(GdkEventButton* event) {
+    ensure_layout_();
+    Cell cell;
+    if (!cell_at_(event->x, event->y, cell)) {
+        // clicking the background hides the window, see GridWindow::on_button_press_event
+        return false;
+    }
+    if (event->type != GDK_BUTTON_PRESS) {
+        return true;
+    }
+    auto* box = box_at_(cell);
+    if (window.config.pins && event->button == 3) { // right-clicked
+        window.toggle_pinned(*box);
+    } else {
+        window.run_box(*box);
+    }
+    return true;
+}
+
+bool GridView::on_scroll_event(GdkEventScroll* event) {
+    double delta;
+    switch (event->direction) {
+        case GDK_SCROLL_UP:     delta = -1; break;
+        case GDK_SCROLL_DOWN:   delta = 1; break;
+        case GDK_SCROLL_SMOOTH: delta = event->delta_y; break;
+        default: return false;
+    }
+    // set_value clamps the value
+    vadjustment->set_value(vadjustment->get_value() + delta * vadjustment->get_step_increment());
+    return true;
+}
+
+bool GridView::on_key_press_event(GdkEventKey* event) {
+    ensure_layout_();
+    // the other keys are handled by GridWindow, see GridWindow::on_key_press_event
+    switch (event->keyval) {
+        case GDK_KEY_Left:  return move_(0, -1);
+        case GDK_KEY_Right: return move_(0, 1);
+        case GDK_KEY_Up:    return move_(-1, 0);
+        case GDK_KEY_Down:  return move_(1, 0);
+        case GDK_KEY_Return:
+            if (selected) {
+                window.run_box(*selected);
+                return true;
+            }
+            break;
+    }
+    return Gtk::DrawingArea::on_key_press_event(event);
+}
+
+bool GridView::on_focus_in_event(GdkEventFocus* event) {
+    ensure_layout_();
+    if (!selected) {
+        select_first(false);
+    } else {
+        window.set_description(selected->comment);
+    }
+    queue_draw();
+    return Gtk::DrawingArea::on_focus_in_event(event);
+}
+
+bool GridView::on_focus_out_event(GdkEventFocus* event) {
+    queue_draw();
+    return Gtk::DrawingArea::on_focus_out_event(event);
+}
+
+void GridView::select_(Cell cell) {
+    selected_cell = cell;
+    selected = box_at_(cell);
+    window.set_description(selected->comment);
+    scroll_to_(cell);
+    queue_draw();
+}
+
+void GridView::select_first(bool prefer_apps) {
+    ensure_layout_();
+    if (prefer_apps && sections[Apps]->size()) {
+        select_({ Apps, 0 });
+        grab_focus();
+        return;
+    }
+    for (std::size_t s = 0; s < sections.size(); ++s) {
+        if (sections[s]->size()) {
+            select_({ s, 0 });
+            grab_focus();
+            return;
+        }
+    }
+    selected = nullptr;
+}
+
+bool GridView::move_(int rows, int cols) {
+    if (!selected) {
+        select_first(false);
+        return selected != nullptr;
+    }
+    auto [s, index] = selected_cell;
+    auto size = sections[s]->size();
+    // left & right walk the cells in order, crossing the sections
+    if (cols < 0) {
+        if (index > 0) {
+            select_({ s, index - 1 });
+            return true;
+        }
+        for (auto prev = s; prev-- > 0;) {
+            if (auto prev_size = sections[prev]->size()) {
+                select_({ prev, prev_size - 1 });
+                return true;
+            }
+        }
+        return false;
+    }
+    if (cols > 0) {
+        if (index + 1 < size) {
+            select_({ s, index + 1 });
+            return true;
+        }
+        for (auto next = s + 1; next < sections.size(); ++next) {
+            if (sections[next]->size()) {
+                select_({ next, 0 });
+                return true;
+            }
+        }
+        return false;
+    }
+    // up & down keep the column, crossing to the adjacent section at its last or first row
+    auto && layout = layouts[s];
+    auto row = index / layout.cols;
+    auto col = index % layout.cols;
+    if (rows < 0 && row > 0) {
+        select_({ s, index - layout.cols });
+        return true;
+    }
+    if (rows > 0 && row + 1 < layout.rows) {
+        select_({ s, std::min(index + layout.cols, size - 1) });
+        return true;
+    }
+    for (auto next = static_cast<int>(s) + rows; next >= 0 && next < static_cast<int>(sections.size()); next += rows) {
+        auto next_size = sections[next]->size();
+        if (next_size == 0) {
+            continue;
+        }
+        auto && next_layout = layouts[next];
+        auto next_row = rows < 0 ? next_layout.rows - 1 : 0;
+        auto next_index = next_row * next_layout.cols + std::min(col, next_layout.cols - 1);
+        select_({ static_cast<std::size_t>(next), std::min(next_index, next_size - 1) });
+        return true;
+    }
+    return false;
+}
+
+void GridView::scroll_to_(Cell cell) {
+    int x, y;
+    cell_origin_(cell, x, y);
+    auto value = vadjustment->get_value();
+    auto page = vadjustment->get_page_size();
+    if (y < value) {
+        vadjustment->set_value(y);
+    } else if (y + cell_height > value + page) {
+        vadjustment->set_value(y + cell_height - page);
+    }
+}
+
+void GridView::scroll_to_top() {
+    vadjustment->set_value(vadjustment->get_lower());
+}
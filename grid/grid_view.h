@@ -0,0 +1,107 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <gtkmm.h>
+
+#include "grid.h"
+
+/*
+ * GridView draws the pinned, favourite & common boxes as three sections of one grid, enabled with -virtual.
+ * Cells have the same size, so the layout is arithmetic and only the rows intersecting the visible
+ * area are painted; neither showing nor scrolling depend on the number of entries.
+ * The boxes serve as the model: their names, comments & the icons set to their images are drawn,
+ * but they are never realized. This saves the size negotiation & the CSS matching of the FlowBoxes,
+ * not memory: every box still owns its button, image & label.
+ * Keyboard navigation, hover descriptions, running & pinning are handled the way GridBox handles them.
+ * The view scrolls itself, attach a scrollbar to `get_vadjustment`.
+ */
+class GridView: public Gtk::DrawingArea {
+public:
+    enum Section: std::size_t {
+        Pinned = 0,
+        Favs,
+        Apps
+    };
+
+    GridView(GridWindow& window, BoxesModel& pinned, BoxesModel& favs, BoxesModel& apps);
+    GridView(const GridView&) = delete;
+    ~GridView();
+
+    const Glib::RefPtr<Gtk::Adjustment>& get_vadjustment() { return vadjustment; }
+    // lays the sections out again, call it when the columns or the icon size change
+    void refresh();
+    // repaints the newly loaded icons, lays the sections out again only if the icon size changed
+    void icons_changed();
+    // selects the first cell of the apps section if `prefer_apps`, otherwise of the first non-empty section
+    void select_first(bool prefer_apps);
+    void scroll_to_top();
+protected:
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
+    void on_size_allocate(Gtk::Allocation& allocation) override;
+    void on_style_updated() override;
+    void get_preferred_width_vfunc(int& minimum, int& natural) const override;
+    void get_preferred_height_vfunc(int& minimum, int& natural) const override;
+    bool on_motion_notify_event(GdkEventMotion* event) override;
+    bool on_leave_notify_event(GdkEventCrossing* event) override;
+    bool on_button_press_event(GdkEventButton* event) override;
+    bool on_scroll_event(GdkEventScroll* event) override;
+    bool on_key_press_event(GdkEventKey* event) override;
+    bool on_focus_in_event(GdkEventFocus* event) override;
+    bool on_focus_out_event(GdkEventFocus* event) override;
+private:
+    struct Cell {
+        std::size_t section;
+        std::size_t index;
+    };
+    // position of the section in the content, which is `content_height` tall
+    struct Layout {
+        int         x;    // of the first column, the rows are centered
+        int         y;
+        std::size_t cols;
+        std::size_t rows;
+    };
+
+    GridWindow&                   window;
+    std::array<BoxesModel*, 3>    sections;
+    std::array<Layout, 3>         layouts{};
+    Glib::RefPtr<Gtk::Adjustment> vadjustment;
+    Glib::RefPtr<Pango::Layout>   label; // reused by all cells
+    int                           icon_size{ 0 }; // the cells are sized for
+    int                           cell_width{ 0 };
+    int                           cell_height{ 0 };
+    int                           label_height{ 0 };
+    int                           char_width{ 0 };
+    int                           content_height{ 0 };
+    GridBox*                      hovered{ nullptr };
+    GridBox*                      selected{ nullptr };
+    Cell                          selected_cell{ 0, 0 };
+    sigc::connection              relayout_idle; // connected while the boxes have changed, but not laid out
+
+    // positions the sections after their boxes or the allocation have changed
+    void relayout_();
+    // relayouts on idle, once for any number of changes
+    void queue_relayout_();
+    // relayouts now if it is queued, the layout & the boxes are used together
+    void ensure_layout_();
+    GridBox* box_at_(Cell cell) const;
+    // the cell under the point in widget coordinates
+    bool cell_at_(double x, double y, Cell& cell) const;
+    // the top left corner of the cell in content coordinates
+    void cell_origin_(Cell cell, int& x, int& y) const;
+    void select_(Cell cell);
+    // moves the selection by `rows` & `cols`, crossing the sections; returns false at the edges
+    bool move_(int rows, int cols);
+    void scroll_to_(Cell cell);
+    void update_metrics_();
+    void update_adjustment_();
+};
@@ -0,0 +1,289 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+
+#include "on_desktop_entry.h"
+
+namespace {
+    using namespace std::string_view_literals;
+
+    // .desktop files are tiny, anything bigger is not one
+    constexpr std::size_t MAX_FILE_SIZE = 1024 * 1024;
+
+    enum class Key: std::uint8_t {
+        Unknown = 0,
+        Name,
+        Exec,
+        Icon,
+        Comment,
+        MimeType,
+        Keywords,
+        TryExec,
+        Categories,
+        OnlyShowIn,
+        NotShowIn,
+        StartupWMClass,
+        Actions,
+        Terminal,
+        NoDisplay,
+        Hidden
+    };
+
+    // the keys are told apart by their length first, so at most three comparisons are made
+    Key classify(std::string_view key) {
+        switch (key.size()) {
+            case 4:
+                if (key == "Name"sv) return Key::Name;
+                if (key == "Exec"sv) return Key::Exec;
+                if (key == "Icon"sv) return Key::Icon;
+                break;
+            case 6:
+                if (key == "Hidden"sv) return Key::Hidden;
+                break;
+            case 7:
+                if (key == "Comment"sv) return Key::Comment;
+                if (key == "TryExec"sv) return Key::TryExec;
+                if (key == "Actions"sv) return Key::Actions;
+                break;
+            case 8:
+                if (key == "Keywords"sv) return Key::Keywords;
+                if (key == "Terminal"sv) return Key::Terminal;
+                if (key == "MimeType"sv) return Key::MimeType;
+                break;
+            case 9:
+                if (key == "NoDisplay"sv) return Key::NoDisplay;
+                if (key == "NotShowIn"sv) return Key::NotShowIn;
+                break;
+            case 10:
+                if (key == "Categories"sv) return Key::Categories;
+                if (key == "OnlyShowIn"sv) return Key::OnlyShowIn;
+                break;
+            case 14:
+                if (key == "StartupWMClass"sv) return Key::StartupWMClass;
+                break;
+        }
+        return Key::Unknown;
+    }
+
+    inline std::string_view trim(std::string_view str) {
+        auto begin = str.find_first_not_of(" \t");
+        if (begin == str.npos) {
+            return {};
+        }
+        auto end = str.find_last_not_of(" \t\r");
+        return str.substr(begin, end - begin + 1);
+    }
+
+    // reads the file to `buffer`, reusing its storage
+    bool read_file(const fs::path& path, std::string& buffer) {
+        auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) > MAX_FILE_SIZE) {
+            close(fd);
+            return false;
+        }
+        // the size is a hint, the file may change while it's read
+        buffer.resize(std::max<std::size_t>(st.st_size, 4096));
+        std::size_t size = 0;
+        for (;;) {
+            if (size == buffer.size()) {
+                if (size >= MAX_FILE_SIZE) {
+                    close(fd);
+                    return false;
+                }
+                buffer.resize(size * 2);
+            }
+            auto n = read(fd, buffer.data() + size, buffer.size() - size);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                close(fd);
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            size += n;
+        }
+        close(fd);
+        buffer.resize(size);
+        return true;
+    }
+
+    // whether ';'-separated `list` contains any of `items`
+    bool list_contains_any(std::string_view list, const std::vector<std::string>& items) {
+        while (!list.empty()) {
+            auto end = std::min(list.find(';'), list.size());
+            auto item = list.substr(0, end);
+            for (auto && other: items) {
+                if (item == other) {
+                    return true;
+                }
+            }
+            list.remove_prefix(std::min(end + 1, list.size()));
+        }
+        return false;
+    }
+
+    bool is_executable(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+    }
+
+    std::vector<std::string> split_env(const char* name, std::string_view separator) {
+        std::vector<std::string> result;
+        if (auto* value = getenv(name)) {
+            for (auto && item: split_string(value, separator)) {
+                if (!item.empty()) {
+                    result.emplace_back(item);
+                }
+            }
+        }
+        return result;
+    }
+}
+
+DesktopEntryConfig::DesktopEntryConfig(std::string_view lang):
+    lang{ lang },
+    current_desktops{ split_env("XDG_CURRENT_DESKTOP", ":") },
+    path_dirs{ split_env("PATH", ":") }
+{
+    // intentionally left blank
+}
+
+DesktopEntryState parse_desktop_entry(const fs::path& path, const DesktopEntryConfig& config, DesktopEntry& entry) {
+    thread_local std::string buffer;
+    if (!read_file(path, buffer)) {
+        return DesktopEntryState::Error;
+    }
+    // values point into `buffer` until they are packed into `entry` at the end
+    std::array<std::string_view, static_cast<std::size_t>(Key::Actions) + 1> values{};
+    std::string_view name_ln;     // localized: Name[lang]
+    std::string_view comment_ln;  // localized: Comment[lang]
+    std::string_view keywords_ln; // localized: Keywords[lang]
+    bool terminal = false;
+    bool in_group = false;
+    bool found_group = false;
+
+    std::string_view text{ buffer };
+    while (!text.empty()) {
+        auto eol = std::min(text.find('\n'), text.size());
+        auto line = text.substr(0, eol);
+        text.remove_prefix(std::min(eol + 1, text.size()));
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '[') {
+            if (in_group) { // the next group begins
+                break;
+            }
+            in_group = trim(line) == "[Desktop Entry]"sv;
+            found_group = found_group || in_group;
+            continue;
+        }
+        if (!in_group) {
+            continue;
+        }
+        auto eq = line.find('=');
+        if (eq == line.npos) {
+            continue;
+        }
+        auto key = trim(line.substr(0, eq));
+        auto value = trim(line.substr(eq + 1));
+        if (!key.empty() && key.back() == ']') {
+            // Key[locale]=value
+            auto open = key.find('[');
+            if (open == key.npos || key.substr(open + 1, key.size() - open - 2) != config.lang) {
+                continue;
+            }
+            switch (classify(key.substr(0, open))) {
+                case Key::Name:     name_ln = value; break;
+                case Key::Comment:  comment_ln = value; break;
+                case Key::Keywords: keywords_ln = value; break;
+                default: break;
+            }
+            continue;
+        }
+        auto k = classify(key);
+        switch (k) {
+            case Key::Unknown: break;
+            case Key::Terminal: terminal = value == "true"sv; break;
+            case Key::NoDisplay:
+            case Key::Hidden:
+                if (value == "true"sv) {
+                    return DesktopEntryState::Hidden;
+                }
+                break;
+            case Key::Exec:
+                // drop the field codes, we don't pass files or urls
+                value = value.substr(0, value.find(" %"));
+                [[fallthrough]];
+            default:
+                values[static_cast<std::size_t>(k)] = value;
+        }
+    }
+    if (!found_group) {
+        return DesktopEntryState::Error;
+    }
+
+    auto value = [&values](Key k) { return values[static_cast<std::size_t>(k)]; };
+    entry.name = name_ln.empty() ? value(Key::Name) : name_ln;
+    entry.exec = value(Key::Exec);
+    if (entry.name.empty() || entry.exec.empty()) {
+        return DesktopEntryState::Error;
+    }
+    entry.icon = value(Key::Icon);
+    entry.comment = comment_ln.empty() ? value(Key::Comment) : comment_ln;
+    entry.mime_type = value(Key::MimeType);
+    entry.keywords = keywords_ln.empty() ? value(Key::Keywords) : keywords_ln;
+    entry.try_exec = value(Key::TryExec);
+    entry.categories = value(Key::Categories);
+    entry.only_show_in = value(Key::OnlyShowIn);
+    entry.not_show_in = value(Key::NotShowIn);
+    entry.startup_wm_class = value(Key::StartupWMClass);
+    entry.actions = value(Key::Actions);
+    // Exec is kept as is, the terminal is prefixed when the entry is run
+    entry.terminal = terminal;
+    entry.pack();
+    return DesktopEntryState::Ok;
+}
+
+bool shown_in_environment(const DesktopEntry& entry, const DesktopEntryConfig& config) {
+    if (!entry.only_show_in.empty() && !list_contains_any(entry.only_show_in, config.current_desktops)) {
+        return false;
+    }
+    if (!entry.not_show_in.empty() && list_contains_any(entry.not_show_in, config.current_desktops)) {
+        return false;
+    }
+    if (!entry.try_exec.empty()) {
+        if (entry.try_exec.find('/') != std::string_view::npos) {
+            return is_executable(std::string{ entry.try_exec });
+        }
+        std::string candidate;
+        for (auto && dir: config.path_dirs) {
+            candidate = concat(dir, '/', entry.try_exec);
+            if (is_executable(candidate)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
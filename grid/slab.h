@@ -0,0 +1,163 @@
+/* GTK-based application grid
+ * Copyright (c) 2021 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/* Slab stores objects in cells of fixed-size chunks: the objects never move, so they need not be movable,
+ * and they are allocated CHUNK_SIZE at a time next to each other; freed cells are reused first.
+ * Objects are referred to by handles holding the cell index & the generation of the cell,
+ * which changes each time the cell is freed, so a stale handle is detected instead of dangling.
+ * Iteration visits the live objects in the cell order, i.e. mostly sequentially in memory. */
+template <typename T, std::size_t CHUNK_SIZE = 64>
+class Slab {
+public:
+    static constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+    struct Handle {
+        std::uint32_t index{ NONE };
+        std::uint32_t generation{ 0 };
+    };
+
+    Slab() = default;
+    Slab(const Slab&) = delete;
+    ~Slab() {
+        clear();
+    }
+
+    template <typename ... Ts>
+    Handle emplace(Ts && ... args) {
+        std::uint32_t index;
+        if (!free_cells.empty()) {
+            index = free_cells.back();
+            free_cells.pop_back();
+        } else {
+            if (cells_used == chunks.size() * CHUNK_SIZE) {
+                chunks.emplace_back(new Cell[CHUNK_SIZE]);
+            }
+            index = cells_used++;
+        }
+        auto && cell = cell_(index);
+        new (cell.storage) T(std::forward<Ts>(args)...);
+        cell.live = true;
+        ++count;
+        return { index, cell.generation };
+    }
+    // destroys the object, the handle & all of its copies become stale
+    void erase(Handle handle) {
+        if (auto* object = get(handle)) {
+            auto && cell = cell_(handle.index);
+            object->~T();
+            cell.live = false;
+            ++cell.generation;
+            free_cells.push_back(handle.index);
+            --count;
+        }
+    }
+    // the object or nullptr if the handle is stale
+    T* get(Handle handle) {
+        if (handle.index >= cells_used) {
+            return nullptr;
+        }
+        auto && cell = cell_(handle.index);
+        if (!cell.live || cell.generation != handle.generation) {
+            return nullptr;
+        }
+        return cell.object();
+    }
+    std::size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    // destroys all objects, all handles become stale; the chunks are kept
+    void clear() {
+        for (std::uint32_t index = 0; index < cells_used; ++index) {
+            if (auto && cell = cell_(index); cell.live) {
+                cell.object()->~T();
+                cell.live = false;
+                ++cell.generation;
+                free_cells.push_back(index);
+            }
+        }
+        count = 0;
+    }
+
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = T*;
+        using reference         = T&;
+
+        iterator(Slab& slab, std::uint32_t index): slab{ &slab }, index{ index } {
+            skip_();
+        }
+        T& operator*() const {
+            return *slab->cell_(index).object();
+        }
+        T* operator->() const {
+            return slab->cell_(index).object();
+        }
+        iterator& operator++() {
+            ++index;
+            skip_();
+            return *this;
+        }
+        bool operator==(const iterator& other) const {
+            return index == other.index;
+        }
+        bool operator!=(const iterator& other) const {
+            return index != other.index;
+        }
+    private:
+        Slab*         slab;
+        std::uint32_t index;
+
+        void skip_() {
+            while (index < slab->cells_used && !slab->cell_(index).live) {
+                ++index;
+            }
+        }
+    };
+    iterator begin() {
+        return { *this, 0 };
+    }
+    iterator end() {
+        return { *this, cells_used };
+    }
+private:
+    struct Cell {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::uint32_t generation{ 0 };
+        bool          live{ false };
+
+        T* object() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    std::vector<std::unique_ptr<Cell[]>> chunks;
+    std::vector<std::uint32_t>           free_cells;   // reused before new ones are taken
+    std::uint32_t                        cells_used{ 0 }; // cells taken from the chunks, live or free
+    std::size_t                          count{ 0 };      // live objects
+
+    Cell& cell_(std::uint32_t index) const {
+        return chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+    }
+};